@@ -40,12 +40,13 @@ TASK_3( int, fanout, int, leaf_size, int, width, int, depth )
 {
   if( depth > 0 ) {
     int n,i;
-    for( i = 0; i < width-1; i++ ) {
-      SPAWN( fanout, leaf_size, width, depth-1 );
-    }
+    int r[width];
+
+    SPAWN_N( fanout, i, width-1, leaf_size, width, depth-1 );
     n = CALL( fanout, leaf_size, width, depth-1 );
+    SYNC_N( fanout, width-1, r );
     for( i = 0; i < width-1; i++ ) {
-      n += SYNC( fanout );
+      n += r[i];
     }
     return n;
   } else {
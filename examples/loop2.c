@@ -49,7 +49,11 @@ TASK_2( int, main, int, argc, char **, argv )
   int i;
 
   for( i=0; i<s_iters; i++ ) {
+#ifdef USE_RFOR
+    RFOR( work, 0, p_iters, grainsize );
+#else
     FOR( work, 0, p_iters, grainsize );
+#endif
   }
 
   printf( "%d %d %d\n", grainsize, p_iters, s_iters );
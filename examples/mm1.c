@@ -84,7 +84,11 @@ TASK_2(int, main, int, argc, char**, argv) {
 
   /* Multiply matrices */
 
+#ifdef USE_RFOR
+  RFOR( mm, 0, rows, rows, a, b, c );
+#else
   FOR( mm, 0, rows, rows, a, b, c );
+#endif
 
   /* Check result */
 
@@ -38,32 +38,42 @@
 // More parallelism
 // Repeats <n> times
 
-void mul_block( double* a, double* b, double* c, int rows, int bs, int ii, int jj, int kk )
+// Multiplies the bs x bs block at row ii and column kk of a with the
+// block at row kk of b, for the columns [j0, j1) of c. The innermost
+// loop runs along rows of b and c and vectorizes.
+
+void mul_block( double* a, double* b, double* c, int rows, int bs, int ii, int j0, int j1, int kk )
 {
   int ilim = ii+bs <= rows ? ii+bs : rows;
+  int klim = kk+bs <= rows ? kk+bs : rows;
   int i;
-  //printf( "ii: %d jj %d kk: %d\n", ii, jj, kk );
   for( i = ii; i < ilim; i++ ) {
-    int jlim = jj+bs <= rows ? jj+bs : rows;
-    int j;
-    for( j = jj; j < jlim; j++ ) {
-      int klim = kk+bs <= rows ? kk+bs : rows;
-      double sum = kk==0 ? 0.0 : c[i*rows+j];
-      int k;
-      for( k = kk; k < klim; k++ ) {
-        sum += a[i*rows+k]*b[k*rows+j];
+    double *ci = c + i*rows;
+    int j, k;
+    if( kk == 0 ) {
+      for( j = j0; j < j1; j++ ) {
+        ci[j] = 0.0;
+      }
+    }
+    for( k = kk; k < klim; k++ ) {
+      double aik = a[i*rows+k];
+      double *bk = b + k*rows;
+      for( j = j0; j < j1; j++ ) {
+        ci[j] += aik * bk[j];
       }
-      c[i*rows+j] = sum;
     }
   }
 }
 
-LOOP_BODY_6( mmj, LARGE_BODY, int, jj, int, i, int, rows, int, bs, double*, a, double*, b, double*, c)
+// The cost is understated so that chunks are about 32 columns wide;
+// narrower chunks make the inner loop too short to vectorize well.
+
+RANGE_BODY_6( mmj, LARGE_BODY/32, int, j0, j1, int, i, int, rows, int, bs, double*, a, double*, b, double*, c)
 {
-  int j = jj*bs, k;
+  int k;
 
   for( k=0; k<rows; k+=bs ) {
-    mul_block( a, b, c, rows, bs, i, j, k );
+    mul_block( a, b, c, rows, bs, i, j0, j1, k );
   }
 }
 
@@ -71,7 +81,7 @@ LOOP_BODY_5( mm, LARGE_BODY, int, ii, int, rows, int, bs, double*, a, double*, b
 {
   int i = ii*bs;
 
-  FOR( mmj, 0, (rows+bs-1)/bs, i, rows, bs, a, b, c );
+  FOR( mmj, 0, rows, i, rows, bs, a, b, c );
 }
 
 
@@ -50,21 +50,31 @@ LOOP_BODY_4( mm, LARGE_BODY/8, int, i, int, rows, double*, a, double*, b, double
   }
 }
 
+// Band w of n of the rows, mailed to worker w so that it gets the same
+// rows in every repetition.
+
+VOID_TASK_6( mm_band, int, w, int, n, int, rows, double*, a, double*, b, double*, c )
+{
+  FOR( mm, w*rows/n, (w+1)*rows/n, rows, a, b, c );
+}
+
 
 TASK_2(int, main, int, argc, char**, argv) {
   int i,j,ok;
   double *a,*b,*c;
   int rows;
-  int reps;
+  int reps, pinned, n;
 
   /* Decode arguments */
 
   if(argc < 3) {
-    fprintf(stderr, "Usage: %s [wool options] <matrix rows> <repetitions>\n", argv[0]);
+    fprintf(stderr, "Usage: %s [wool options] <matrix rows> <repetitions> [a]\n", argv[0]);
     exit(1);
   }
   rows = atoi(argv[1]);
   reps = atoi(argv[2]);
+  pinned = argc > 3 && argv[3][0] == 'a';
+  n = wool_get_nworkers();
 
 
   /* Allocate and initialize matrices */
@@ -86,7 +96,21 @@ TASK_2(int, main, int, argc, char**, argv) {
   /* Multiply matrices */
 
   for( i=0; i<reps; i++ ) {
-    FOR( mm, 0, rows, rows, a, b, c );
+    if( pinned ) {
+      for( j=1; j<n; j++ ) {
+        SPAWN_ON( j, mm_band, j, n, rows, a, b, c );
+      }
+      CALL( mm_band, 0, n, rows, a, b, c );
+      for( j=1; j<n; j++ ) {
+        SYNC( mm_band );
+      }
+    } else {
+#ifdef USE_RFOR
+      RFOR( mm, 0, rows, rows, a, b, c );
+#else
+      FOR( mm, 0, rows, rows, a, b, c );
+#endif
+    }
   }
 
   /* Check result */
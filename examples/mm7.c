@@ -87,7 +87,11 @@ TASK_2(int, main, int, argc, char**, argv) {
 
   for( i=0; i<reps; i++ ) {
     double *t;
+#ifdef USE_RFOR
+    RFOR( mm, 0, rows, rows, a, b, c );
+#else
     FOR( mm, 0, rows, rows, a, b, c );
+#endif
     t = a; a = c; c = t;
   }
 
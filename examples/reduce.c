@@ -0,0 +1,75 @@
+/*
+   This file is part of Wool, a library for fine-grained independent
+   task parallelism
+
+   Copyright 2009- Karl-Filip Faxén, kff@sics.se
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+       * Redistributions of source code must retain the above copyright
+         notice, this list of conditions and the following disclaimer.
+       * Redistributions in binary form must reproduce the above copyright
+         notice, this list of conditions and the following disclaimer in the
+         documentation and/or other materials provided with the distribution.
+       * Neither "Wool" nor the names of its contributors may be used to endorse
+         or promote products derived from this software without specific prior
+         written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+   ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+   WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR OTHER CONTRIBUTORS BE LIABLE FOR ANY
+   DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+   ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+   This is Wool version @WOOL_VERSION@
+*/
+
+#include "wool.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+// Sums the squares of an array with a parallel reduction loop.
+// Usage: reduce [wool options] <elements> <repetitions> [r]
+// With the r flag, the loop runs on range descriptors (RFOR).
+
+#define SUM(x,y) ((x)+(y))
+
+REDUCE_BODY_1( sumsq, SMALL_BODY, long, i, double, 0.0, SUM, double *, a )
+{
+  return a[i] * a[i];
+}
+
+TASK_2( int, main, int, argc, char **, argv )
+{
+  long i, n;
+  int reps, ranged;
+  double *a, s = 0.0;
+
+  if( argc < 3 ) {
+    fprintf( stderr, "Usage: reduce [<wool opts>] <elements> <reps> [r]\n" );
+    return 1;
+  }
+
+  n = atol( argv[1] );
+  reps = atoi( argv[2] );
+  ranged = argc > 3 && argv[3][0] == 'r';
+
+  a = (double *) malloc( n * sizeof(double) );
+  for( i = 0; i < n; i++ ) {
+    a[i] = (double) (i % 10);
+  }
+
+  for( i = 0; i < reps; i++ ) {
+    s += ranged ? RFOR( sumsq, 0, n, a ) : FOR( sumsq, 0, n, a );
+  }
+
+  printf( "%.0f\n", s );
+
+  return 0;
+}
@@ -45,7 +45,8 @@ TASK_3( int, tree, int, d, int, s, int, n )
     } else {
       l = s;
     }
-    SPAWN( tree, d-r, s, n );
+    // The deeper subtree has more leaves, so depth serves as cost
+    SPAWN_COST( tree, d-r, d-r, s, n );
     a = CALL( tree, d-l, s, n);
     b = SYNC( tree );
     return a+b;
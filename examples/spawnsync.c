@@ -0,0 +1,96 @@
+/*
+   This file is part of Wool, a library for fine-grained independent
+   task parallelism
+
+   Copyright 2009- Karl-Filip Faxén, kff@sics.se
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+       * Redistributions of source code must retain the above copyright
+         notice, this list of conditions and the following disclaimer.
+       * Redistributions in binary form must reproduce the above copyright
+         notice, this list of conditions and the following disclaimer in the
+         documentation and/or other materials provided with the distribution.
+       * Neither "Wool" nor the names of its contributors may be used to endorse
+         or promote products derived from this software without specific prior
+         written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+   ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+   WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR OTHER CONTRIBUTORS BE LIABLE FOR ANY
+   DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+   ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+   This is Wool version @WOOL_VERSION@
+*/
+
+#include "wool.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+// Times the owner side of the sync protocol: one spawn at a time, joined
+// at once, so every join takes the task back from the thieves. One more
+// task waits below them, so that the joins are not of the last task in
+// the pool, which some protocols always take the slow way.
+// Usage: spawnsync [wool options] <pairs> <repetitions>
+// Compare builds with and without WOOL_ASYM_FENCE (and CHASE_LEV_SYNC).
+
+TASK_1( long, leaf, long, i )
+{
+  return i & 7;
+}
+
+TASK_1( long, pairs, long, n )
+{
+  long i, s = 0;
+
+  SPAWN( leaf, 0 );
+  for( i = 0; i < n; i++ ) {
+    SPAWN( leaf, i );
+    s += SYNC( leaf );
+  }
+  return s + SYNC( leaf );
+}
+
+static double seconds( void )
+{
+  struct timespec t;
+
+  clock_gettime( CLOCK_MONOTONIC, &t );
+  return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+TASK_2( int, main, int, argc, char **, argv )
+{
+  long n, s = 0;
+  int i, reps;
+  double t, best = 0.0;
+
+  if( argc < 3 ) {
+    fprintf( stderr, "Usage: spawnsync [<wool opts>] <pairs> <reps>\n" );
+    return 1;
+  }
+
+  n = atol( argv[1] );
+  reps = atoi( argv[2] );
+
+  for( i = 0; i < reps; i++ ) {
+    t = seconds();
+    s += CALL( pairs, n );
+    t = seconds() - t;
+    if( i == 0 || t < best ) {
+      best = t;
+    }
+  }
+
+  printf( "%ld, %.2f ns per spawn and sync\n", s, best * 1e9 / n );
+
+  return 0;
+}
@@ -53,10 +53,8 @@ static int work( int leaf_size, int width )
     loop(1000);
   }
   
-  for( i = 0; i < width; i++ ) {
-    SYNC( fanout );
-  }
-  
+  SYNC_N( fanout, width );
+
   for( i = 0; i < width; i++ ) {
     sum += arr[i];
   }
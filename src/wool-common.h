@@ -107,6 +107,21 @@
   #define TWO_FIELD_SYNC 1
 #endif
 
+#ifndef CHASE_LEV_SYNC
+  #define CHASE_LEV_SYNC 0  /* Owner and thieves race on the bottom index as in a Chase-Lev deque */
+#endif
+
+#ifndef WOOL_ASYM_FENCE
+  #define WOOL_ASYM_FENCE 0  /* Thieves force the owners' store-load fences with membarrier() */
+#endif
+
+#if CHASE_LEV_SYNC
+  // Every task is public and bot only moves one step at a time
+  #define WOOL_DEFER_BOT_DEC 0
+  #define WOOL_ADD_STEALABLE 0
+  #define WOOL_AFFINITY 0
+#endif
+
 #ifndef WOOL_BALARM_CACHING
   #define WOOL_BALARM_CACHING 0
 #endif
@@ -137,10 +152,47 @@
   #define SPAWN_FENCE 0  /* correct for x86 */
 #endif
 
+#ifndef WOOL_LAZY_SPLIT
+  #define WOOL_LAZY_SPLIT 1
+#endif
+
+#ifndef WOOL_LAZY_SPAWN
+  #define WOOL_LAZY_SPAWN 0  /* >0: SPAWN runs the child at once while this many public tasks are unstolen */
+#endif
+
+#ifndef WOOL_RECV_INIT
+  #define WOOL_RECV_INIT 0  /* Private pools; owners hand tasks to thieves that ask for them */
+#endif
+
+#if WOOL_RECV_INIT
+  #define WOOL_AFFINITY 0   /* Mailed tasks are never public, so nobody could take them */
+#endif
+
+#ifndef WOOL_AFFINITY
+  #define WOOL_AFFINITY 1  /* SPAWN_ON mails tasks to workers, who look there before stealing */
+#endif
+
+#ifndef WOOL_COST_HINTS
+  #define WOOL_COST_HINTS 0  /* Descriptors carry a cost estimate for sampling thieves */
+#endif
+
+#ifndef WOOL_REDUCERS
+  #define WOOL_REDUCERS 1
+#endif
+
+#ifndef WOOL_MAX_REDUCERS
+  #define WOOL_MAX_REDUCERS 64
+#endif
+
 #ifndef FINEST_GRAIN
   #define FINEST_GRAIN 2000
 #endif
 
+// Chunks of RANGE_BODY_n loops are multiples of this many iterations
+#ifndef WOOL_VECTOR_WIDTH
+  #define WOOL_VECTOR_WIDTH 8
+#endif
+
 #ifndef MAKE_TRACE
   #define MAKE_TRACE 0
 #endif
@@ -267,9 +319,26 @@
 #define ROUND(x,b) ( (x) + PAD( (x), (b) ) )
 #define _WOOL_ALIGNTO(n, t) ((n + _WOOL_ALIGNOF(t) - 1) & ~( _WOOL_ALIGNOF(t) - 1 ))  /* Alignment must be a power of 2 */
 #define _WOOL_OFFSET_AFTER(n, t) (_WOOL_ALIGNTO(n, t) + sizeof(t))
+#define _WOOL_ROUND_UP(x, w) ( ( (x) + (w) - 1 ) / (w) * (w) )
+#define _WOOL_ROUND_DOWN(x, w) ( (x) - ( (x) % (w) + (w) ) % (w) )  /* Also for x < 0 */
 
 #ifndef TASK_PAYLOAD
-  #define TASK_PAYLOAD (_WOOL_MAX_ARITY*8)
+  #define TASK_PAYLOAD 32
+#endif
+
+// Task descriptors are padded to a multiple of TASK_ROUND. The defaults give
+// 64 byte descriptors, one per cache line. Rounding to less than LINE_SIZE
+// packs more descriptors per line at the cost of some false sharing between
+// neighbouring public tasks. Argument lists that do not fit in the payload
+// are spilled to a per worker arena, see _WOOL_(spill_push); a result that
+// does not fit beside the stolen task info fails NAME_TD_FITS_IN_TASK at
+// compile time and needs a larger TASK_PAYLOAD.
+// All descriptors of a build have the same size: the pool, the join stack
+// and the thieves find a task from its index, which a stride per task type
+// would turn into a walk over the pool.
+
+#ifndef TASK_ROUND
+  #define TASK_ROUND LINE_SIZE
 #endif
 
 unsigned block_size(int);
@@ -290,6 +359,23 @@ typedef volatile unsigned long exarg_t;
   #endif
 #endif
 
+#if CHASE_LEV_SYNC && ( !TWO_FIELD_SYNC || !_WOOL_ordered_stores || WOOL_RECV_INIT )
+  #error "CHASE_LEV_SYNC needs TWO_FIELD_SYNC and ordered stores, and no WOOL_RECV_INIT"
+#endif
+
+#if WOOL_ASYM_FENCE && !defined(__linux__)
+  #error "WOOL_ASYM_FENCE needs the membarrier() system call of Linux"
+#endif
+
+#if CHASE_LEV_SYNC
+  // The owner bumps the bits of dq_bot above the index whenever it takes
+  // back the bottom of its pool, so that no thief can act on a stale bot.
+  #define _WOOL_CL_TAG          ( 1UL << 40 )
+  #define _WOOL_BOT_IDX( b )    ( (b) & ( _WOOL_CL_TAG - 1 ) )
+#else
+  #define _WOOL_BOT_IDX( b )    ( b )
+#endif
+
 #if defined(__sparc__)
   #define SFENCE        asm volatile( "membar #StoreStore" )
   #define MFENCE        asm volatile( "membar #StoreLoad|#StoreStore" )
@@ -345,6 +431,18 @@ typedef volatile unsigned long exarg_t;
   #define READ_INT_ACQ(var,ty) (var)
 #endif
 
+// A store-load fence that only the owner of a pool executes. With
+// WOOL_ASYM_FENCE, the other side calls membarrier() instead, which makes
+// every running worker execute a full fence; the owner then only needs to
+// keep the compiler from moving its loads above its stores. If the kernel
+// refuses membarrier(), both sides fall back to MFENCE.
+#if WOOL_ASYM_FENCE
+  #define OWNER_FENCE \
+    do { if( _WOOL_(asym_fences) ) { COMPILER_FENCE; } else { MFENCE; } } while( 0 )
+#else
+  #define OWNER_FENCE   MFENCE
+#endif
+
 #define STORE_WRAPPER_REL(var,val)  STORE_PTR_REL( (var), (val) )
 #define READ_WRAPPER_ACQ(var)       READ_PTR_ACQ( (var), _wool_task_header_t )
 #if WOOL_BALARM_CACHING
@@ -368,6 +466,13 @@ WOOL_WHEN_MSPAN( extern void __wool_set_span( hrtime_t ); )
 #endif
 #define PR_INC(s,i)  PR_ADD(s,i,1)
 
+// High water marks are counters too; the total is the sum over workers
+#if COUNT_EVENTS
+#define PR_MAX(s,i,k) ( ((s)->pr.ctr[i]) < (unsigned long long) (k) ? ((s)->pr.ctr[i]) = (k) : 0 )
+#else
+#define PR_MAX(s,i,k) /* Empty */
+#endif
+
 #if COUNT_EVENTS_EXP
 #define PR_INC_EXP(s,i) (PR_INC(s,i))
 #else
@@ -440,6 +545,21 @@ typedef enum {
 #endif
   CTR_trlf,
   CTR_trlf_iters,
+  CTR_injected,
+  CTR_parks,
+  CTR_wakes,
+  CTR_park_us,
+  CTR_wake_ns,
+  CTR_steal_local,
+  CTR_steal_remote,
+  CTR_pool_grown,
+  CTR_trims,
+  CTR_pool_hwm_kb,
+  CTR_js_hwm_kb,
+  CTR_steal_batched,
+  CTR_lazy,
+  CTR_mailed,
+  CTR_mail_steals,
   CTR_MAX
 } CTR_index;
 
@@ -471,6 +591,13 @@ struct _Worker;
   #define WOOL_JOIN_LOCK_FIELD
 #endif
 
+#if WOOL_COST_HINTS
+  // Expected work of the task, as given to SPAWN_COST; 0 if unknown
+  #define WOOL_COST_FIELD volatile long cost;
+#else
+  #define WOOL_COST_FIELD
+#endif
+
 #if TWO_FIELD_SYNC
 #define TASK_COMMON_FIELDS(ty)    \
   WOOL_WHEN_MSPAN( hrtime_t spawn_span; ) \
@@ -478,12 +605,14 @@ struct _Worker;
   WOOL_LINK_FIELD \
   volatile unsigned long ssn;   \
   volatile balarm_t balarm; \
-  WOOL_JOIN_LOCK_FIELD
+  WOOL_JOIN_LOCK_FIELD \
+  WOOL_COST_FIELD
 #else
 #define TASK_COMMON_FIELDS(ty)    \
   WOOL_WHEN_MSPAN( hrtime_t spawn_span; ) \
   _wool_task_header_t hdr;  \
-  balarm_t balarm;
+  balarm_t balarm; \
+  WOOL_COST_FIELD
 #endif
 
 typedef struct _Task * (* wrapper_t)( struct _Worker *, struct _Task * );
@@ -510,15 +639,20 @@ typedef struct _Task {
   TASK_COMMON_FIELDS( struct _Task * )
   char p1[ PAD( COMMON_FIELD_SIZE, P_SZ ) ];
   char d[ TASK_PAYLOAD ];
-  char p2[ PAD( ROUND( COMMON_FIELD_SIZE, P_SZ ) + TASK_PAYLOAD, LINE_SIZE ) ];
+  char p2[ PAD( ROUND( COMMON_FIELD_SIZE, P_SZ ) + TASK_PAYLOAD, TASK_ROUND ) ];
 } Task;
 
 struct _WOOL_(_StolenTask);
 
+// Written by the thief in the descriptor of a stolen task, over what were
+// its arguments, so only stolen tasks pay for them.
 typedef struct {
 #if WOOL_JOIN_STACK
   struct _WOOL_(_StolenTask) *next;
+#endif
   int size;
+#if WOOL_REDUCERS
+  struct _wool_views *volatile views; // Reducer views of the task, set before DONE
 #endif
 } _WOOL_(StolenTaskInfo);
 
@@ -605,6 +739,15 @@ typedef struct _WOOL_(_StolenTask) {
   #endif
 #endif
 
+// The public copy of the block pointers. When the pool grows, the owner
+// publishes a new table, so a thief sees a size and blocks that agree.
+
+typedef struct _WOOL_(_BlockTable) {
+  int                         n_blocks;  // A power of two
+  struct _WOOL_(_BlockTable) *older;     // Superseded table, see free_older_tables()
+  Task                       *block[];
+} _WOOL_(BlockTable);
+
 struct _Worker_private {
   // First cache line, private stuff often written by the owner
   unsigned long long ctr[CTR_MAX];
@@ -622,6 +765,13 @@ struct _Worker_private {
   Task             *join_stack_base;
   _WOOL_(StolenTask) *join_stack_top;
   _WOOL_(StolenTask) *join_stack_free;
+  _WOOL_(StolenTask) *join_stack_bump;   // Slots from here up have never been used
+  _WOOL_(StolenTask) *join_stack_end;
+  _WOOL_(StolenTask) *join_stack_hwm;    // Slots from here up are not committed
+#endif
+  char             *spill_top;          // Spilled argument lists, a stack in spawn order
+  char             *spill_end;
+#if WOOL_JOIN_STACK
   unsigned long     join_stack_top_idx; // The join stack index of the first task logically outside the join stack
   unsigned long     pool_base_idx; // The pool index of the oldest task in the pool
 #endif
@@ -631,10 +781,19 @@ struct _Worker_private {
   Task             *pr_top;             // A copy of the top pointer, used for forests
   Task             *dq_base;            // Always pointing the base of the dequeue
   Task             *curr_block_base;
-  Task             *block_base[_WOOL_pool_blocks];
+  Task            **block_base;         // n_blocks entries, grows when the pool is full
+  int               n_blocks;
+  Task            **spare_blocks;       // Blocks given back to the OS, ready for reuse, see put_spare()
+  int               n_spare;
+  unsigned long     n_resident;         // Task descriptors in the blocks of the block table
+  int               trim_pending;       // Work was done since the last trim
   // Externally managed storage area for "Wool-plugins". Initialized to
-  // NULL by init_worker().
+  // NULL by init_worker(). With WOOL_REDUCERS, the reducer views of the
+  // task the worker is running.
   void             *storage;
+#if WOOL_COST_HINTS
+  long              next_cost;          // Cost of the next spawn, set by SPAWN_COST
+#endif
 #if LOG_EVENTS
   LogEntry         *logptr;
 #else
@@ -664,7 +823,7 @@ struct _Worker_public {
   volatile unsigned long  dq_bot;      // The next task to steal
   volatile unsigned long  ssn;         // Sequence number, incremented when bot is decreased
   volatile unsigned long  pu_n_public; // Number of public task descriptors in pool, == n_public
-           Task          *pu_block_base[_WOOL_pool_blocks]; // Public copy of the block pointers
+  struct _WOOL_(_BlockTable) *volatile pu_blocks; // Public copy of the block pointers
 #if WOOL_JOIN_STACK
   volatile unsigned long long pool_base_idx; // Thieves use this one
 #endif
@@ -679,6 +838,20 @@ struct _Worker_public {
   wool_cond_t    work_available;
   workfun_t      fun;
   void           *fun_arg;
+  volatile int   parked;       // Nonzero while the worker sleeps in park()
+#if WOOL_AFFINITY
+  volatile unsigned long mailbox; // The latest letter from SPAWN_ON, 0 if none
+#endif
+#if CHASE_LEV_SYNC
+  volatile unsigned long cl_top; // Index of the first free descriptor, written by the owner
+#endif
+#if WOOL_RECV_INIT
+  volatile int   ri_request;   // Index plus one of a thief asking us for a task, 0 if none
+  _wool_task_header_t volatile ri_card; // Our own request: the header of the task we get,
+  Task *volatile ri_join;      // the task we are joining with or NULL,
+  Task *volatile ri_reply;     // and the answer, NULL until the victim has given it
+  _wool_task_header_t volatile ri_f;    // The wrapper of the task in ri_reply
+#endif
 };
 
 typedef struct _Worker {
@@ -767,7 +940,7 @@ extern "C" {
 
 
 #if THE_SYNC
-  balarm_t _WOOL_(sync_get_balarm)( Task * );
+  balarm_t _WOOL_(sync_get_balarm)( volatile Task * );
 #endif
 
 static inline void* _WOOL_(getspecific)( _wool_thread_local_t key )
@@ -813,15 +986,73 @@ static inline Worker *_WOOL_(slow_get_self)( void )
 Task *_WOOL_(slow_spawn)( Worker *, Task *, _wool_task_header_t );
 Task *_WOOL_(slow_sync)( Worker *, Task *, grab_res_t );
 Worker *_WOOL_(slow_get_self)( void );
+#if CHASE_LEV_SYNC
+grab_res_t _WOOL_(cl_pop_last)( Worker *, unsigned long );
+#endif
+#if WOOL_ASYM_FENCE
+extern int _WOOL_(asym_fences);
+#endif
 
 int  wool_init( int, char ** );
 int  wool_init_options( int, char ** );
 void wool_init_start( void );
 void wool_fini( void );
+void wool_suspend( void );
+void wool_resume( void );
 int  wool_get_nworkers( void );
 int  wool_get_worker_id( void );
 void work_for( workfun_t, void * );
 
+// Thread safe submission of root tasks, also from threads that are not workers
+typedef struct _wool_future wool_future_t;
+
+wool_future_t *wool_submit( workfun_t, void * );
+int   wool_future_done( wool_future_t * );
+void *wool_future_wait( wool_future_t * );
+void  wool_future_free( wool_future_t * );
+
+#if WOOL_REDUCERS
+
+// Reducer variables. Outside stolen tasks, REDUCER_VIEW gives the
+// leftmost view, the user's own variable. A stolen task gets a new view,
+// initialised by 'identity', the first time it asks for one, and the
+// join with the stolen task folds that view into the joiner's with
+// 'reduce', in the order of the sequential program: what the joiner did
+// before the join comes to the left. A root task from wool_submit() also
+// starts with no views; they are folded in when its future is waited for.
+//
+// A reducer is registered, and takes one of WOOL_MAX_REDUCERS slots in
+// the view tables, the first time a task asks it for a view. It must stay
+// allocated until it is given back with wool_reducer_retire(), which may
+// only be called when no task uses it and every task that did is joined.
+
+typedef struct _wool_reducer {
+  size_t  size;                             // Bytes in a view
+  void  (*identity)( void *view );          // Initialises a new view
+  void  (*reduce)( void *left, void *right ); // left := left + right
+  void   *leftmost;
+  int     id;                               // 0 until first used in a stolen task
+} wool_reducer_t;
+
+#define WOOL_REDUCER( size, identity, reduce, leftmost ) \
+  { (size), (identity), (reduce), (leftmost), 0 }
+
+typedef struct _wool_views {
+  void *view[ WOOL_MAX_REDUCERS ];
+} _wool_views_t;
+
+extern _wool_views_t _WOOL_(no_views);
+
+void *_WOOL_(new_view)( Worker *, wool_reducer_t * );
+void  _WOOL_(merge_views)( Worker *, _wool_views_t * );
+void  wool_reducer_retire( wool_reducer_t * );
+
+#endif
+
+#if WOOL_AFFINITY
+  void _WOOL_(post_mail)( Worker *, int, unsigned long );
+#endif
+
 #if WOOL_PIE_TIMES
   void time_event( Worker *, int );
 #else
@@ -883,7 +1114,7 @@ static inline grab_res_t _WOOL_(owner_grab)( volatile Task *t )
   if( a==NOT_STOLEN ) {
     return a;
   } else {
-    return sync_get_balarm( t );
+    return _WOOL_(sync_get_balarm)( t );
   }
 #elif SINGLE_FIELD_SYNC
 
@@ -910,6 +1141,16 @@ static inline grab_res_t _WOOL_(owner_grab)( volatile Task *t )
 #endif
 }
 
+// With CHASE_LEV_SYNC, thieves see the tasks below the index published here
+static inline __attribute__((__always_inline__))
+void _WOOL_(cl_publish)( Worker *self, Task *top )
+{
+  #if CHASE_LEV_SYNC
+    COMPILER_FENCE;
+    self->pu.cl_top = self->pr.curr_block_fidx + ( top - self->pr.curr_block_base );
+  #endif
+}
+
 /* The fast functions are responsible for
    1. determining if the fast case applies
    2. generating a new value for top
@@ -983,6 +1224,7 @@ void _WOOL_(fast_spawn)( Worker *self, Task *cached_top, _wool_task_header_t f )
       COMPILER_FENCE;
       cached_top->hdr = f;
       cached_top ++;
+      _WOOL_(cl_publish)( self, cached_top );
     } else {
       /* Slow case */
       cached_top = _WOOL_(slow_spawn)( self, cached_top, f );
@@ -1030,6 +1272,64 @@ void _WOOL_(fast_spawn)( Worker *self, Task *cached_top, _wool_task_header_t f )
   self->pr.pr_top = cached_top;
 }
 
+// SPAWN_N fills a run of descriptors in the current block without the
+// checks of fast_spawn, and moves top once at the end. The run must end
+// below spawn_high, so that no descriptor in it is the last one of the
+// block and no exception is pending; otherwise every task is spawned on
+// its own. On machines without ordered stores, public and private spawns
+// differ, so there we always take the latter route.
+
+static inline __attribute__((__always_inline__))
+Task *_WOOL_(spawn_reserve)( Worker *self, long n )
+{
+  #if _WOOL_ordered_stores
+    Task *top = self->pr.pr_top;
+
+    if( n > 0 && n <= self->pr.spawn_high - top ) {
+      return top;
+    }
+  #endif
+  return NULL;
+}
+
+// Stores the cost given to SPAWN_COST, if any, in the task being spawned.
+static inline __attribute__((__always_inline__))
+void _WOOL_(spawn_cost)( Worker *self, Task *t )
+{
+  #if WOOL_COST_HINTS
+    t->cost = self->pr.next_cost;
+    self->pr.next_cost = 0;
+  #endif
+}
+
+static inline __attribute__((__always_inline__))
+void _WOOL_(spawn_at)( Worker *self, Task *t, _wool_task_header_t f )
+{
+  _WOOL_(spawn_cost)( self, t );
+  #if WOOL_MEASURE_SPAN
+    t->spawn_span = __wool_update_time();
+  #endif
+  #if WOOL_DEFER_NOT_STOLEN && !SINGLE_FIELD_SYNC && !TWO_FIELD_SYNC
+    t->balarm = NOT_STOLEN;
+  #endif
+  COMPILER_FENCE;
+  t->hdr = f;
+}
+
+static inline __attribute__((__always_inline__))
+void _WOOL_(spawn_commit)( Worker *self, Task *top )
+{
+  self->pr.pr_top = top;
+  _WOOL_(cl_publish)( self, top );
+}
+
+// The pool index of the next task to be spawned
+static inline __attribute__((__always_inline__))
+unsigned long _WOOL_(top_idx)( Worker *self )
+{
+  return self->pr.curr_block_fidx + ( self->pr.pr_top - self->pr.curr_block_base );
+}
+
 static inline __attribute__((__always_inline__))
 void _wool_when_sync_on_public( Worker *self )
 {
@@ -1055,7 +1355,18 @@ void _wool_when_sync_on_public( Worker *self )
 static inline __attribute__((__always_inline__))
 grab_res_t _WOOL_(grab_in_sync)( Worker *self, Task *top )
 {
-  #if TWO_FIELD_SYNC
+  #if CHASE_LEV_SYNC
+    // Take top back from the thieves, then see whether they got there first
+    unsigned long t_idx = self->pr.curr_block_fidx + ( top - self->pr.curr_block_base );
+
+    self->pu.cl_top = t_idx;
+    OWNER_FENCE;
+    _WOOL_(when_sync_on_public)( self );
+    if( __builtin_expect( _WOOL_BOT_IDX( self->pu.dq_bot ) < t_idx, 1 ) ) {
+      return TF_FREE;
+    }
+    return _WOOL_(cl_pop_last)( self, t_idx );
+  #elif TWO_FIELD_SYNC
     balarm_t res = _WOOL_(exch_busy_balarm)( &(top->balarm) );
 
     // fprintf( stderr, "?\n" );
@@ -1079,7 +1390,7 @@ grab_res_t _WOOL_(grab_in_sync)( Worker *self, Task *top )
 static inline __attribute__((always_inline))
 unsigned long _WOOL_(max)( unsigned long a, unsigned long b )
 {
-  return b<a ? b : a;
+  return a<b ? b : a;
 }
 
 static inline __attribute__((always_inline))
@@ -1095,6 +1406,294 @@ char* _WOOL_(arg_ptr)( Task* t, size_t alignment )
   return ((char *) t) + sizeplusalign - sizeplusalign % alignment;
 }
 
+// Argument lists that do not fit in a descriptor, alignment padding
+// included, live in the spawning worker's spill arena; the descriptor holds
+// a pointer to them. Since tasks are joined in reverse spawn order, the
+// arena is a stack. Each block ends with the previous top, so the join
+// needs no size information. Lazy spawns push their frame markers here
+// too, see _WOOL_(spawn_lazy).
+
+#define _WOOL_SPILL_ALIGN 16
+
+void _WOOL_(spill_overflow)( void );
+
+static inline __attribute__((always_inline))
+char *_WOOL_(spill_push)( Worker *self, size_t size, size_t align )
+{
+  char *prev = self->pr.spill_top;
+  char *p = align <= _WOOL_SPILL_ALIGN ? prev
+            : (char *) _WOOL_ROUND_UP( (unsigned long) prev, align );
+  char *top = p + ROUND( size, _WOOL_SPILL_ALIGN ) + _WOOL_SPILL_ALIGN;
+
+  if( __builtin_expect( top > self->pr.spill_end, 0 ) ) {
+    _WOOL_(spill_overflow)();
+  }
+  ((char **) top)[-1] = prev;
+  self->pr.spill_top = top;
+  return p;
+}
+
+static inline __attribute__((always_inline))
+void _WOOL_(spill_pop)( Worker *self )
+{
+  self->pr.spill_top = ((char **) self->pr.spill_top)[-1];
+}
+
+// The pointer to a spilled argument list follows the common fields with
+// its own alignment; the alignment of the arguments could put it past the
+// end of the descriptor.
+static inline __attribute__((always_inline))
+char **_WOOL_(spill_slot)( Task *t )
+{
+  return (char **) _WOOL_(arg_ptr)( t, __alignof__(char *) );
+}
+
+static inline __attribute__((always_inline))
+char *_WOOL_(task_args)( Task *t, size_t alignment, int spilled )
+{
+  return spilled ? *_WOOL_(spill_slot)( t ) : _WOOL_(arg_ptr)( t, alignment );
+}
+
+// Loops from LOOP_BODY_n run in chunks of NAME##__min_iters__ iterations
+// and split off the upper half of what remains only when there is demand:
+// a thief has asked for more public tasks, or every task the worker has
+// spawned is stolen already. With WOOL_LAZY_SPLIT=0, loops split eagerly
+// down to chunk size, as a balanced tree.
+
+static inline __attribute__((always_inline))
+int _WOOL_(split_wanted)( Worker *self )
+{
+  if( WOOL_LAZY_SPLIT ) {
+    unsigned long top = self->pr.curr_block_fidx + ( self->pr.pr_top - self->pr.curr_block_base );
+
+    return self->pr.more_public_wanted || _WOOL_BOT_IDX( self->pu.dq_bot ) >= top;
+  } else {
+    return 1;
+  }
+}
+
+// With WOOL_LAZY_SPAWN, a spawn that would get a private task descriptor
+// runs the child at once, as a call, as long as no thief has asked for
+// more public tasks and at least WOOL_LAZY_SPAWN public tasks are still
+// unstolen. Such a spawn publishes nothing and leaves top alone; it only
+// pushes a frame marker on the spill arena: the result, the views of the
+// child, and the top the spawn was made at, in the last word. Spawns and
+// syncs nest, so a sync that finds its own top there belongs to a lazy
+// spawn; any other spawn would have moved top or left a spill block, whose
+// last word points into the arena. The arena starts with a zeroed guard
+// word, and while it holds anything, no block is evacuated to the join
+// stack, so no other pool index can share the address. Results aligned to
+// more than _WOOL_SPILL_ALIGN are always spawned the ordinary way. The
+// child runs with views of its own, like a stolen task, which the sync
+// merges to the right of those of the continuation.
+
+static inline __attribute__((always_inline))
+int _WOOL_(spawn_inline)( Worker *self, Task *top )
+{
+  if( WOOL_LAZY_SPAWN ) {
+    unsigned long idx = self->pr.curr_block_fidx + ( top - self->pr.curr_block_base );
+    unsigned long pub = self->pr.n_public;
+
+    return idx >= pub && !self->pr.more_public_wanted
+           && ( _WOOL_BOT_IDX( self->pu.dq_bot ) + WOOL_LAZY_SPAWN <= pub || pub == 0 );
+  } else {
+    return 0;
+  }
+}
+
+// Before the child runs; a cost hint has no descriptor to go to and must
+// not reach the child's own spawns
+static inline __attribute__((always_inline))
+void *_WOOL_(spawn_enter)( Worker *self )
+{
+  #if WOOL_COST_HINTS
+    self->pr.next_cost = 0;
+  #endif
+  #if WOOL_REDUCERS
+    void *views = self->pr.storage;
+
+    self->pr.storage = &_WOOL_(no_views);
+    return views;
+  #else
+    return NULL;
+  #endif
+}
+
+// The size of the frame marker for a result of size bytes
+#define _WOOL_LAZY_SIZE(size) \
+  ROUND( (size) + ( WOOL_REDUCERS ? 2 : 1 ) * sizeof(void *), _WOOL_SPILL_ALIGN )
+
+// After the child has run; returns where its result goes
+static inline __attribute__((always_inline))
+char *_WOOL_(spawn_lazy)( Worker *self, Task *top, size_t size, void *views )
+{
+  char *p = self->pr.spill_top;
+  char *end = p + _WOOL_LAZY_SIZE( size );
+
+  if( __builtin_expect( end > self->pr.spill_end, 0 ) ) {
+    _WOOL_(spill_overflow)();
+  }
+  ((Task **) end)[-1] = top;
+  #if WOOL_REDUCERS
+    ((void **) end)[-2] = self->pr.storage == &_WOOL_(no_views) ? NULL : self->pr.storage;
+    self->pr.storage = views;
+  #endif
+  self->pr.spill_top = end;
+  PR_INC( self, CTR_lazy );
+  return p;
+}
+
+static inline __attribute__((always_inline))
+int _WOOL_(sync_is_lazy)( Worker *self, Task *top )
+{
+  return ((Task **) self->pr.spill_top)[-1] == top;
+}
+
+// The result stored by _WOOL_(spawn_lazy), valid until _WOOL_(sync_lazy)
+static inline __attribute__((always_inline))
+char *_WOOL_(lazy_result)( Worker *self, size_t size )
+{
+  return self->pr.spill_top - _WOOL_LAZY_SIZE( size );
+}
+
+static inline __attribute__((always_inline))
+void _WOOL_(sync_lazy)( Worker *self, size_t size )
+{
+  #if WOOL_REDUCERS
+    _wool_views_t *views = ((_wool_views_t **) self->pr.spill_top)[-2];
+  #endif
+
+  self->pr.spill_top -= _WOOL_LAZY_SIZE( size );
+  #if WOOL_REDUCERS
+    if( views != NULL ) {
+      _WOOL_(merge_views)( self, views );
+    }
+  #endif
+}
+
+// Loops run with RFOR keep their remaining iterations [next, end) in a
+// range descriptor on the owner's stack. The owner takes chunks from the
+// bottom; a thief that steals the loop's splitter task takes the upper
+// half of what remains. As in the THE protocol, the owner moves 'next'
+// without the lock and only takes it when a thief may have moved 'end'
+// past the chunk it just claimed; thieves always hold the lock.
+
+typedef struct {
+  volatile long next, end;
+  volatile int  lock;
+  volatile int  taken;   // A thief split the range with the current splitter task
+} _wool_range_t;
+
+static inline __attribute__((always_inline))
+void _WOOL_(range_lock)( _wool_range_t *r )
+{
+  int lock_var;
+  do {
+    lock_var = 1;
+    EXCHANGE( lock_var, r->lock );
+  } while( lock_var == 1 );
+}
+
+static inline __attribute__((always_inline))
+void _WOOL_(range_unlock)( _wool_range_t *r )
+{
+  STORE_INT_REL( r->lock, 0 );
+}
+
+static inline __attribute__((always_inline))
+void _WOOL_(range_init)( _wool_range_t *r, long from, long to )
+{
+  r->next = from;
+  r->end = to;
+  r->lock = 0;
+  r->taken = 0;
+}
+
+// Owner side: claim the next chunk of at most 'chunk' iterations, ending
+// on a multiple of 'align' unless it is the last one.
+static inline __attribute__((always_inline))
+int _WOOL_(range_take)( _wool_range_t *r, long chunk, long align, long *lo, long *hi )
+{
+  long n = r->next, e = r->end, h;
+
+  if( n >= e ) {
+    return 0;
+  }
+  h = e - n > chunk ? _WOOL_ROUND_DOWN( n + chunk, align ) : e;
+  r->next = h;
+  MFENCE;
+  if( __builtin_expect( h > r->end, 0 ) ) {
+    // A thief took part of the chunk; wait for it to settle 'end'
+    _WOOL_(range_lock)( r );
+    if( h > r->end ) {
+      h = r->end > n ? r->end : n;
+      r->next = h;
+    }
+    _WOOL_(range_unlock)( r );
+    if( h == n ) {
+      return 0;
+    }
+  }
+  *lo = n;
+  *hi = h;
+  return 1;
+}
+
+// Thief side: take the upper half of the remaining range, split on a
+// multiple of 'align', unless fewer than two chunks remain.
+static inline __attribute__((always_inline))
+int _WOOL_(range_split)( _wool_range_t *r, long chunk, long align, long *lo, long *hi )
+{
+  long e, mid;
+
+  _WOOL_(range_lock)( r );
+  e = r->end;
+  mid = _WOOL_ROUND_DOWN( e - ( e - r->next ) / 2, align );
+  if( e - r->next < 2 * chunk ) {
+    _WOOL_(range_unlock)( r );
+    return 0;
+  }
+  r->end = mid;
+  MFENCE;
+  if( r->next > mid ) {
+    // The owner got there first
+    r->end = e;
+    _WOOL_(range_unlock)( r );
+    return 0;
+  }
+  // The owner needs a new splitter only if this one got something
+  r->taken = 1;
+  _WOOL_(range_unlock)( r );
+  *lo = mid;
+  *hi = e;
+  return 1;
+}
+
+#if WOOL_REDUCERS
+
+// The views of the current strand are in the worker's storage area; NULL
+// means the leftmost views, &_WOOL_(no_views) a stolen task with no views
+// of its own yet.
+
+static inline __attribute__((always_inline))
+void *_WOOL_(reducer_view)( Worker *self, wool_reducer_t *r )
+{
+  _wool_views_t *v = (_wool_views_t *) self->pr.storage;
+
+  if( v == NULL ) {
+    return r->leftmost;
+  } else if( r->id > 0 && v->view[ r->id-1 ] != NULL ) {
+    return v->view[ r->id-1 ];
+  } else {
+    return _WOOL_(new_view)( self, r );
+  }
+}
+
+#define REDUCER_VIEW( r ) \
+  ( _WOOL_(reducer_view)( _WOOL_(get_self)( (Worker *) __self, _WOOL_(in_task) ), (r) ) )
+
+#endif
+
 #define WOOL_WAIT_CHECK(var) {if(++var >= 1000000000) {var = 0; fprintf( stderr, "Long wait at %s:%d\n", __FILE__, __LINE__ );}}
 
 #if WOOL_JOIN_STACK
@@ -1162,10 +1761,55 @@ Task* _WOOL_(swap_link)( Task *volatile *link, Task *old_link )
 
 #define SYNC( f )        ( f##_SYNC_DSP( (Worker *) __self, _WOOL_(in_task) ) )
 #define SYNC_ALL( f, m ) { WOOL_CONTEXT_CACHE; while ( GET_MARK() != m ) { SYNC( f ); } }
+// SPAWN_N spawns count tasks f, evaluating the arguments once for each of them
+// with i running from 0 to count-1. SYNC_N joins the count tasks f spawned last;
+// for tasks with a result, the one of the i:th is stored in res[i] unless
+// res is NULL.
+#define SPAWN_N( f, i, count, ... ) \
+  { Worker *const _WOOL_(w) = _WOOL_(get_self)( (Worker *) __self, _WOOL_(in_task) ); \
+    const long _WOOL_(n_spawn) = (count); \
+    Task *const _WOOL_(run) = _WOOL_(spawn_reserve)( _WOOL_(w), _WOOL_(n_spawn) ); \
+    if( _WOOL_(run) != NULL ) { \
+      for( i = 0; i < _WOOL_(n_spawn); i++ ) { \
+        f##_SPAWN_AT( _WOOL_(w), _WOOL_(run) + i ,##__VA_ARGS__ ); \
+      } \
+      _WOOL_(spawn_commit)( _WOOL_(w), _WOOL_(run) + _WOOL_(n_spawn) ); \
+    } else { \
+      for( i = 0; i < _WOOL_(n_spawn); i++ ) { \
+        f##_SPAWN( _WOOL_(w) ,##__VA_ARGS__ ); \
+      } \
+    } }
+#define SYNC_N( f, count, ... ) \
+  ( f##_SYNC_N( _WOOL_(get_self)( (Worker *) __self, _WOOL_(in_task) ), (count) ,##__VA_ARGS__ ) )
 #define GET_MARK()       ( _WOOL_(get_self)((Worker*) __self, _WOOL_(in_task))->pr.pr_top )
 #define SPAWN( f, ... )  ( f##_SPAWN_DSP( (Worker *) __self, _WOOL_(in_task) ,##__VA_ARGS__ ) )
+// SPAWN_COST is SPAWN with an estimate of the work in the task, in any
+// unit as long as it is used consistently; with WOOL_COST_HINTS, sampling
+// thieves go for the victim whose oldest task has the largest estimate.
+#if WOOL_COST_HINTS
+#define SPAWN_COST( f, c, ... ) \
+  ( _WOOL_(get_self)( (Worker *) __self, _WOOL_(in_task) )->pr.next_cost = (c), \
+    SPAWN( f ,##__VA_ARGS__ ) )
+#else
+#define SPAWN_COST( f, c, ... ) SPAWN( f ,##__VA_ARGS__ )
+#endif
+// SPAWN_ON is SPAWN, also telling worker wid that it should preferably
+// run the task. The task can still be stolen by any worker, or inlined.
+#if WOOL_AFFINITY
+#define SPAWN_ON( wid, f, ... ) \
+  { Worker *const _WOOL_(sender) = _WOOL_(get_self)( (Worker *) __self, _WOOL_(in_task) ); \
+    const unsigned long _WOOL_(idx) = _WOOL_(top_idx)( _WOOL_(sender) ); \
+    f##_SPAWN( _WOOL_(sender) ,##__VA_ARGS__ ); \
+    _WOOL_(post_mail)( _WOOL_(sender), (wid), _WOOL_(idx) ); }
+#else
+#define SPAWN_ON( wid, f, ... ) { SPAWN( f ,##__VA_ARGS__ ); }
+#endif
 #define CALL( f, ... )   ( f##_CALL_DSP( (Worker *) __self, _WOOL_(in_task) , ##__VA_ARGS__ ) )
+// FOR and RFOR run loops defined with LOOP_BODY_n, RANGE_BODY_n or
+// REDUCE_BODY_n; for the latter they return the combined result. Parts
+// may be combined in any order, so COMBINE should be commutative too.
 #define FOR( f, ... )    ( CALL( f##_TREE , ##__VA_ARGS__ ) )
+#define RFOR( f, ... )   ( CALL( f##_RANGE , ##__VA_ARGS__ ) )
 #define FREE_SPACE_PTR( f ) ( f##_FREE_SPACE( _WOOL_(get_self)((Worker*) __self, _WOOL_(in_task))->pr.pr_top ) )
 #define FREE_SPACE_SIZE( f ) ( sizeof(Task) - (size_t) f##_FREE_SPACE((Task*) 0) )
 
@@ -67,6 +67,10 @@ if ((r)); then
   OFFSET_EXP="_WOOL_OFFSET_AFTER( $OFFSET_EXP, ATYPE_$r )"
 fi
 
+# A compile time constant, true if the arguments do not fit in a descriptor;
+# they start at the first multiple of their alignment after the common fields
+SPILLED="( _WOOL_ROUND_UP( COMMON_FIELD_SIZE, $ARGS_MAX_ALIGN ) + $OFFSET_EXP > sizeof(Task) )"
+
 
 if ((r)); then
 
@@ -81,6 +85,10 @@ echo \
     void NAME##_SPAWN_DSP( Worker *__self, int _WOOL_(fs_in_task)$ARG_TYPES);
   static inline __attribute__((__always_inline__))
     RTYPE NAME##_SYNC_DSP( Worker *__self, int _WOOL_(fs_in_task) );
+  static inline __attribute__((__always_inline__))
+    void NAME##_SPAWN_AT( Worker *__self, Task *cached_top$ARG_TYPES);
+  static inline __attribute__((__always_inline__))
+    void NAME##_SYNC_N( Worker *__self, long n, RTYPE *res);
   static inline __attribute__((__always_inline__))
     RTYPE NAME##_CALL_DSP( Worker *__self, int _WOOL_(fs_in_task)$ARG_TYPES);"
 ) | awk '{printf "%-70s\\\n", $0 }'
@@ -94,6 +102,10 @@ echo \
     void NAME##_SPAWN_DSP( Worker *__self, int _WOOL_(fs_in_task)$ARG_TYPES);
   static inline __attribute__((__always_inline__))
     void NAME##_SYNC_DSP( Worker *__self, int _WOOL_(fs_in_task) );
+  static inline __attribute__((__always_inline__))
+    void NAME##_SPAWN_AT( Worker *__self, Task *cached_top$ARG_TYPES);
+  static inline __attribute__((__always_inline__))
+    void NAME##_SYNC_N( Worker *__self, long n);
   static inline __attribute__((__always_inline__))
     void NAME##_CALL_DSP( Worker *__self, int _WOOL_(fs_in_task)$ARG_TYPES);"
 ) | awk '{printf "%-70s\\\n", $0 }'
@@ -119,6 +131,17 @@ TASK_IMPL_$r(RTYPE, NAME$MACRO_ARGS)"
   ASSIGN_RES="res = "
   RES_VAR="res"
   TASK_SIZE="sizeof(NAME##_TD)"
+  RES_SIZE="sizeof(RTYPE)"
+  RES_ALIGN="__alignof__(RTYPE)"
+  SAVE_TO_lazy="*(RTYPE *)"
+  SAVE_FROM_lazy="= res"
+  LOAD_FROM_lazy="res = *(RTYPE *) _WOOL_(lazy_result)( __self, sizeof(RTYPE) );"
+  SYNC_N_FORMALS=", RTYPE *res"
+  SYNC_N_ONE="RTYPE r = NAME##_SYNC( __self );
+
+    if( res != NULL ) {
+      res[i] = r;
+    }"
 else
   DEF_MACRO_LHS="#define VOID_TASK_$r(NAME$MACRO_ARGS )"
   DCL_MACRO_LHS="#define VOID_TASK_DECL_$r(NAME$MACRO_DECL_ARGS)"
@@ -134,6 +157,13 @@ VOID_TASK_IMPL_$r(NAME$MACRO_ARGS)"
   ASSIGN_RES=""
   RES_VAR=""
   TASK_SIZE="0"
+  RES_SIZE="0"
+  RES_ALIGN="1"
+  SAVE_TO_lazy="(void)"
+  SAVE_FROM_lazy=""
+  LOAD_FROM_lazy=""
+  SYNC_N_FORMALS=""
+  SYNC_N_ONE="NAME##_SYNC( __self );"
 fi
 
 (\
@@ -147,6 +177,8 @@ typedef struct _##NAME##_TD {
   } d;
 } NAME##_TD;
 
+typedef char NAME##_TD_FITS_IN_TASK[ sizeof(NAME##_TD) <= sizeof(Task) ? 1 : -1 ];
+
 typedef struct {
   Task* (*f)(Worker *__self, NAME##_TD *t);
   int size;
@@ -155,9 +187,10 @@ typedef struct {
 static inline __attribute__((__always_inline__))
 char* NAME##_FREE_SPACE(Task* cached_top)
 {
-  char *_WOOL_(p) = _WOOL_(arg_ptr)( cached_top, $ARGS_MAX_ALIGN );
-
-  return _WOOL_(p) + _WOOL_ALIGNTO( $OFFSET_EXP, double );
+  if( $SPILLED ) {
+    return (char *) _WOOL_(spill_slot)( cached_top ) + _WOOL_ALIGNTO( sizeof(char *), double );
+  }
+  return _WOOL_(arg_ptr)( cached_top, $ARGS_MAX_ALIGN ) + _WOOL_ALIGNTO( $OFFSET_EXP, double );
 }
 
 /** SPAWN related functions **/
@@ -166,13 +199,27 @@ Task* NAME##_WRAP(Worker *__self, NAME##_TD *t);
 
 extern NAME##_DICT_T NAME##_DICT;
 
+$RTYPE NAME##_CALL(Worker *_WOOL_(self) $FUN_a_FORMALS);
+
 static inline __attribute__((__always_inline__))
 void NAME##_SPAWN(Worker *__self $FUN_a_FORMALS)
 {
   Task* cached_top = __self->pr.pr_top;
   char *_WOOL_(p) = _WOOL_(arg_ptr)( cached_top, $ARGS_MAX_ALIGN );
 
+  if( WOOL_LAZY_SPAWN && $RES_ALIGN <= _WOOL_SPILL_ALIGN && _WOOL_(spawn_inline)( __self, cached_top ) ) {
+    void *_WOOL_(views) = _WOOL_(spawn_enter)( __self );
+    $RES_FIELD
+    $ASSIGN_RES NAME##_CALL( __self $CALL_a_ARGS );
+    $SAVE_TO_lazy _WOOL_(spawn_lazy)( __self, cached_top, $RES_SIZE, _WOOL_(views) ) $SAVE_FROM_lazy;
+    return;
+  }
+
+  if( $SPILLED ) {
+    _WOOL_(p) = *_WOOL_(spill_slot)( cached_top ) = _WOOL_(spill_push)( __self, $OFFSET_EXP, $ARGS_MAX_ALIGN );
+  }
 $TASK_a_INIT_p
+  _WOOL_(spawn_cost)( __self, cached_top );
 
   COMPILER_FENCE;
 
@@ -191,9 +238,21 @@ void NAME##_SPAWN_DSP(Worker *__self, int _WOOL_(fs_in_task)$FUN_a_FORMALS)
   }
 }
 
-/** CALL related functions **/
+/* Fills in a descriptor reserved by SPAWN_N; top is not moved */
+static inline __attribute__((__always_inline__))
+void NAME##_SPAWN_AT(Worker *__self, Task *cached_top $FUN_a_FORMALS)
+{
+  char *_WOOL_(p) = _WOOL_(arg_ptr)( cached_top, $ARGS_MAX_ALIGN );
 
-$RTYPE NAME##_CALL(Worker *_WOOL_(self) $FUN_a_FORMALS);
+  if( $SPILLED ) {
+    _WOOL_(p) = *_WOOL_(spill_slot)( cached_top ) = _WOOL_(spill_push)( __self, $OFFSET_EXP, $ARGS_MAX_ALIGN );
+  }
+$TASK_a_INIT_p
+
+  _WOOL_(spawn_at)( __self, cached_top, (_wool_task_header_t) &NAME##_DICT );
+}
+
+/** CALL related functions **/
 
 static inline __attribute__((__always_inline__))
 $RTYPE NAME##_CALL_DSP( Worker *_WOOL_(self), int _WOOL_(fs_in_task)$FUN_a_FORMALS )
@@ -227,9 +286,16 @@ $RTYPE NAME##_SYNC(Worker *__self)
     logEvent( __self, 6 );
   }
 
+  if( WOOL_LAZY_SPAWN && $RES_ALIGN <= _WOOL_SPILL_ALIGN && _WOOL_(sync_is_lazy)( __self, cached_top ) ) {
+    $RES_FIELD
+    $LOAD_FROM_lazy
+    _WOOL_(sync_lazy)( __self, $RES_SIZE );
+    return $RES_VAR;
+  }
+
   if( __builtin_expect( jfp < cached_top, 1 ) ) {
     Task *t = --cached_top;
-    char *_WOOL_(p) = _WOOL_(arg_ptr)( t, $ARGS_MAX_ALIGN );
+    char *_WOOL_(p) = _WOOL_(task_args)( t, $ARGS_MAX_ALIGN, $SPILLED );
     $RES_FIELD
 
     __self->pr.pr_top = cached_top;
@@ -239,12 +305,18 @@ $RTYPE NAME##_SYNC(Worker *__self)
 
     $ASSIGN_RES NAME##_CALL( __self $TASK_GET_FROM_p );
     WOOL_MSPAN_AFTER_INLINE( e_span, t );
+    if( $SPILLED ) {
+      _WOOL_(spill_pop)( __self );
+    }
     if( MAKE_TRACE ) {
       logEvent( __self, 8 );
     }
     return $RES_VAR;
   } else {
     cached_top = NAME##_PUB( __self, cached_top, jfp );
+    if( $SPILLED ) {
+      _WOOL_(spill_pop)( __self );
+    }
     return $RETURN_RES_cached_top;
   }
 }
@@ -258,6 +330,17 @@ $RTYPE NAME##_SYNC_DSP( Worker *__self, int _WOOL_(fs_in_task) )
     __self = _WOOL_(slow_get_self)( );
     return NAME##_SYNC( __self );
   }
+}
+
+/* Joins the last n tasks, latest first; each is inlined unless stolen */
+static inline __attribute__((__always_inline__))
+void NAME##_SYNC_N( Worker *__self, long n$SYNC_N_FORMALS )
+{
+  long i;
+
+  for( i = n-1; i >= 0; i-- ) {
+    $SYNC_N_ONE
+  }
 }" \
 
 ) | awk '{printf "%-70s\\\n", $0 }'
@@ -291,7 +374,7 @@ Task* NAME##_WRAP_AUX(Worker *__self, NAME##_TD *t $FUN_a_FORMALS)
 
 Task* NAME##_WRAP(Worker *__self, NAME##_TD *t)
 {
-  char *_WOOL_(p) = _WOOL_(arg_ptr)( (Task *) t, $ARGS_MAX_ALIGN );
+  char *_WOOL_(p) = _WOOL_(task_args)( (Task *) t, $ARGS_MAX_ALIGN, $SPILLED );
   return NAME##_WRAP_AUX( __self, t $TASK_GET_FROM_p );
 }
 
@@ -318,7 +401,7 @@ Task *NAME##_PUB(Worker *self, Task *top, Task *jfp )
    ) {
     /* Semi fast case */
     NAME##_TD *t = (NAME##_TD *) --top;
-    char *_WOOL_(p) = _WOOL_(arg_ptr)( (Task *) t, $ARGS_MAX_ALIGN );
+    char *_WOOL_(p) = _WOOL_(task_args)( (Task *) t, $ARGS_MAX_ALIGN, $SPILLED );
 
     self->pr.pr_top = top;
     PR_INC( self, CTR_inlined );
@@ -358,33 +441,159 @@ done
 fi
 
 if ((r < $1-1)); then
+for kind in LOOP RANGE REDUCE; do
+
+# LOOP_BODY_n bodies run once per index, RANGE_BODY_n bodies once per
+# chunk; chunks of the latter start and end on multiples of
+# WOOL_VECTOR_WIDTH, except at the ends of the whole loop. REDUCE_BODY_n
+# bodies return a value per index, which is folded into an accumulator
+# local to each loop task; accumulators are combined when split-off
+# parts are joined.
+
+TASK_LHS="VOID_TASK_"
+TASK_RT=""
+ACC_VARS=""
+SYNC_TREE="SYNC( NAME##_TREE );"
+SYNC_SPLIT="SYNC( NAME##_SPLIT );"
+CALL_RANGE="CALL( NAME##_RANGE, (IXTY) __lo, (IXTY) __hi$CALL_a_ARGS );"
+SPLIT_FAIL=""
+RETURN_ACC=""
+
+if [ $kind = LOOP ]; then
+  BODY_LHS="#define LOOP_BODY_$r(NAME, COST, IXTY, IXNAME$MACRO_ARGS)"
+  MIN_ITERS="COST > FINEST_GRAIN ? 1 : FINEST_GRAIN / ( COST ? COST : 20 )"
+  ALIGN="1"
+  BODY_PROTO="static inline void NAME##_LOOP(Worker *__self, IXTY IXNAME$WRK_FORMALS)"
+  TREE_LEAF="for( __i = __from; __i < __end; __i++ ) {
+      NAME##_LOOP( __self, __i$CALL_a_ARGS );
+    }"
+  RANGE_LEAF="for( __i = (IXTY) __lo; __i < (IXTY) __hi; __i++ ) {
+      NAME##_LOOP( __self, __i$CALL_a_ARGS );
+    }"
+  TREE_VARS="IXTY __i, __end;"
+  RANGE_VARS="IXTY __i;
+
+    "
+  TREE_END="__from + NAME##__min_iters__"
+  TREE_MID="__from + (__to - __from) / 2"
+elif [ $kind = RANGE ]; then
+  BODY_LHS="#define RANGE_BODY_$r(NAME, COST, IXTY, FROMNAME, TONAME$MACRO_ARGS)"
+  MIN_ITERS="_WOOL_ROUND_UP( COST > FINEST_GRAIN ? 1 : FINEST_GRAIN / ( COST ? COST : 20 ),
+                    WOOL_VECTOR_WIDTH )"
+  ALIGN="WOOL_VECTOR_WIDTH"
+  BODY_PROTO="static inline void NAME##_CHUNK(Worker *__self, IXTY FROMNAME, IXTY TONAME$WRK_FORMALS)"
+  TREE_LEAF="NAME##_CHUNK( __self, __from, __end$CALL_a_ARGS );"
+  RANGE_LEAF="NAME##_CHUNK( __self, (IXTY) __lo, (IXTY) __hi$CALL_a_ARGS );"
+  TREE_VARS="IXTY __end;"
+  RANGE_VARS=""
+  TREE_END="_WOOL_ROUND_DOWN( __from + NAME##__min_iters__, WOOL_VECTOR_WIDTH )"
+  TREE_MID="_WOOL_ROUND_DOWN( __from + (__to - __from) / 2, WOOL_VECTOR_WIDTH )"
+elif [ $kind = REDUCE ]; then
+  BODY_LHS="#define REDUCE_BODY_$r(NAME, COST, IXTY, IXNAME, RTYPE, IDENTITY, COMBINE$MACRO_ARGS)"
+  MIN_ITERS="COST > FINEST_GRAIN ? 1 : FINEST_GRAIN / ( COST ? COST : 20 )"
+  ALIGN="1"
+  BODY_PROTO="static inline RTYPE NAME##_LOOP(Worker *__self, IXTY IXNAME$WRK_FORMALS)"
+  TREE_LEAF="for( __i = __from; __i < __end; __i++ ) {
+      RTYPE __v = NAME##_LOOP( __self, __i$CALL_a_ARGS );
+      __acc = COMBINE( __acc, __v );
+    }"
+  RANGE_LEAF="for( __i = (IXTY) __lo; __i < (IXTY) __hi; __i++ ) {
+      RTYPE __v = NAME##_LOOP( __self, __i$CALL_a_ARGS );
+      __acc = COMBINE( __acc, __v );
+    }"
+  TREE_VARS="IXTY __i, __end;"
+  RANGE_VARS="IXTY __i;
+
+    "
+  TREE_END="__from + NAME##__min_iters__"
+  TREE_MID="__from + (__to - __from) / 2"
+  TASK_LHS="TASK_"
+  TASK_RT="RTYPE, "
+  ACC_VARS="
+  RTYPE __acc = IDENTITY;"
+  SYNC_TREE="RTYPE __v = SYNC( NAME##_TREE );
+    __acc = COMBINE( __acc, __v );"
+  SYNC_SPLIT="RTYPE __v = SYNC( NAME##_SPLIT );
+    __acc = COMBINE( __acc, __v );"
+  CALL_RANGE="return CALL( NAME##_RANGE, (IXTY) __lo, (IXTY) __hi$CALL_a_ARGS );"
+  SPLIT_FAIL="
+  return IDENTITY;"
+  RETURN_ACC="
+  return __acc;"
+fi
+
 (\
 echo "\
-#define LOOP_BODY_$r(NAME, COST, IXTY, IXNAME$MACRO_ARGS)
+$BODY_LHS
 
 static unsigned long const NAME##__min_iters__
-   = COST > FINEST_GRAIN ? 1 : FINEST_GRAIN / ( COST ? COST : 20 );
+   = $MIN_ITERS;
 
-static inline void NAME##_LOOP(Worker *__self, IXTY IXNAME$WRK_FORMALS);
+$BODY_PROTO;
 
-VOID_TASK_$((r+2))(NAME##_TREE, IXTY, __from, IXTY, __to$MACRO_a_ARGS)
+${TASK_LHS}$((r+2))(${TASK_RT}NAME##_TREE, IXTY, __from, IXTY, __to$MACRO_a_ARGS)
 {
-  if( __to - __from <= NAME##__min_iters__ ) {
-    IXTY __i;
-    for( __i = __from; __i < __to; __i++ ) {
-      NAME##_LOOP( __self, __i$CALL_a_ARGS );
+  int __n_split = 0;$ACC_VARS
+
+  while( __from < __to ) {
+    $TREE_VARS
+
+    if( __to - __from > NAME##__min_iters__ && _WOOL_(split_wanted)( __self ) ) {
+      IXTY __mid = $TREE_MID;
+      if( __mid > __from ) {
+        SPAWN_COST( NAME##_TREE, (long) ( __to - __mid ) * ( COST ? COST : 20 ),
+                    __mid, __to$CALL_a_ARGS );
+        __to = __mid;
+        __n_split++;
+        continue;
+      }
+    }
+    __end = __to - __from > NAME##__min_iters__ ? $TREE_END : __to;
+    $TREE_LEAF
+    __from = __end;
+  }
+  while( __n_split-- > 0 ) {
+    $SYNC_TREE
+  }$RETURN_ACC
+}
+
+${TASK_LHS}DECL_$((r+2))(${TASK_RT}NAME##_RANGE, IXTY, IXTY$MACRO_DECL_ARGS)
+
+${TASK_LHS}$((r+1))(${TASK_RT}NAME##_SPLIT, _wool_range_t *, __rg$MACRO_a_ARGS)
+{
+  long __lo, __hi;
+
+  if( _WOOL_(range_split)( __rg, NAME##__min_iters__, $ALIGN, &__lo, &__hi ) ) {
+    $CALL_RANGE
+  }$SPLIT_FAIL
+}
+
+${TASK_LHS}IMPL_$((r+2))(${TASK_RT}NAME##_RANGE, IXTY, __from, IXTY, __to$MACRO_a_ARGS)
+{
+  _wool_range_t __rg;
+  int __n_split = 1;
+  long __lo, __hi;$ACC_VARS
+
+  _WOOL_(range_init)( &__rg, (long) __from, (long) __to );
+  SPAWN( NAME##_SPLIT, &__rg$CALL_a_ARGS );
+  while( _WOOL_(range_take)( &__rg, NAME##__min_iters__, $ALIGN, &__lo, &__hi ) ) {
+    $RANGE_VARS$RANGE_LEAF
+    if( __rg.taken ) {
+      __rg.taken = 0;
+      SPAWN( NAME##_SPLIT, &__rg$CALL_a_ARGS );
+      __n_split++;
     }
-  } else {
-    IXTY __mid = (__from + __to) / 2;
-    SPAWN( NAME##_TREE, __mid, __to$CALL_a_ARGS );
-    CALL( NAME##_TREE, __from, __mid$CALL_a_ARGS );
-    SYNC( NAME##_TREE );
   }
+  while( __n_split-- > 0 ) {
+    $SYNC_SPLIT
+  }$RETURN_ACC
 }
 
-static inline void NAME##_LOOP(Worker *__self, IXTY IXNAME$WRK_FORMALS)"\
+$BODY_PROTO"\
 ) | awk '{printf "%-70s\\\n", $0 }'
 
+echo ""
+done
 fi
 
 done
@@ -34,7 +34,7 @@
 #include <assert.h>
 #include <sched.h> // For improved multiprocessor performance
 #include <time.h>  // d:o
-#include "wool-common.h"
+#include "wool.h"
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
@@ -43,10 +43,23 @@
 #include <sys/time.h>
 #include <signal.h>
 #include <sys/types.h>
+#include <limits.h>
+#include <dirent.h>
+
+#if defined(__linux__)
+  #include <linux/futex.h>
+  #include <sys/syscall.h>
+  #include <sys/mman.h>
+#endif
+
+#if WOOL_ASYM_FENCE
+  #include <linux/membarrier.h>
+#endif
 
 #define ST_OLD     1
 #define ST_THIEF   2
 #define ST_SAMPLED 4
+#define ST_MAIL    8
 
 #ifndef AVOID_RANDOM
   #define AVOID_RANDOM 0
@@ -135,6 +148,38 @@
   #define WOOL_STEAL_REPF 0
 #endif
 
+#ifndef WOOL_IDLE_PARK
+  #define WOOL_IDLE_PARK 1
+#endif
+
+#ifndef WOOL_INJECT_QUEUE_SIZE
+  #define WOOL_INJECT_QUEUE_SIZE 1024 // Must be a power of two
+#endif
+
+#ifndef WOOL_STEAL_HIER
+  #define WOOL_STEAL_HIER 0
+#endif
+
+#if WOOL_STEAL_HIER && ( !WOOL_STEAL_NEW_SET || WOOL_STEAL_PARSAMP )
+  #error "WOOL_STEAL_HIER needs WOOL_STEAL_NEW_SET and no WOOL_STEAL_PARSAMP"
+#endif
+
+#if WOOL_RECV_INIT || CHASE_LEV_SYNC || THE_SYNC
+  #define WOOL_STEAL_BATCH 0 // Only the two field steal() takes batches
+#endif
+
+#ifndef WOOL_STEAL_BATCH
+  #define WOOL_STEAL_BATCH 1
+#endif
+
+#ifndef WOOL_STEAL_BOARD
+  #define WOOL_STEAL_BOARD WOOL_STEAL_NEW_SET // The steal board, used by '-V board'
+#endif
+
+#if WOOL_STEAL_BATCH && ( !TWO_FIELD_SYNC || THE_SYNC )
+  #error "WOOL_STEAL_BATCH needs TWO_FIELD_SYNC, and no THE_SYNC"
+#endif
+
 #define WOOL_STEAL_SET (WOOL_STEAL_NEW_SET || WOOL_STEAL_OLD_SET)
 
 #ifndef EXACT_STEAL_OUTCOME
@@ -169,6 +214,9 @@
 #define SO_CL    10 // A classical leap as outcome of transitive leap frogging
 
 static void *look_for_work( void *arg );
+static int steal_while_waiting( Worker *self, unsigned int *seedp );
+static void wake_one( Worker *self );
+static void wake_all( void );
 
 WOOL_WHEN_MSPAN( hrtime_t __wool_sc = 1000; )
 
@@ -176,7 +224,7 @@ static Worker **workers;
 static Task   **bases;
 static int n_workers = 0, n_procs = 0, n_threads = 0;
 static int backoff_mode = 960; __attribute__((unused)) // No of iterations of waiting after
-static int n_stealable = -1;
+static int n_stealable = -1, n_stealable_option = -1; // The latter is as given by '-s'
 #if defined(__TILECC__)
   static size_t worker_stack_size = 6*1024*1024;
 #else
@@ -208,6 +256,248 @@ void work_for( workfun_t fun, void *arg )
   }
 }
 
+// Submission of root tasks from threads that are not Wool workers.
+//
+// Submitted work goes into a bounded multi producer, multi consumer queue
+// (Vyukov style, one sequence number per cell) that idle workers check at
+// the top of their steal loop. The submitter gets a future that it can
+// poll or wait on. A worker that waits on a future runs injected work or
+// steals while it waits, so waiting from inside a task never deadlocks the
+// pool.
+// Worker 0 runs main() rather than look_for_work(), so with a single worker
+// submitted work only runs when worker 0 waits on a future or in wool_fini().
+
+struct _wool_future {
+  workfun_t       fun;
+  void           *arg;
+  void           *result;
+#if WOOL_REDUCERS
+  void           *views;      // Reducer views the task created, see collect_views()
+#endif
+  volatile int    done;
+  wool_lock_t     lock;
+  wool_cond_t     cond;
+};
+
+typedef struct {
+  volatile unsigned long  seq;
+  wool_future_t          *fut;
+} inject_cell_t;
+
+static inject_cell_t inject_cells[ WOOL_INJECT_QUEUE_SIZE ];
+static volatile unsigned long inject_head
+                 __attribute__((aligned(LINE_SIZE))) = 0; // Next cell to take from
+static volatile unsigned long inject_tail
+                 __attribute__((aligned(LINE_SIZE))) = 0; // Next cell to put into
+static volatile int inject_ready = 0;
+
+static void init_inject_queue( void )
+{
+  unsigned long i;
+
+  for( i = 0; i < WOOL_INJECT_QUEUE_SIZE; i++ ) {
+    inject_cells[i].seq = i;
+    inject_cells[i].fut = NULL;
+  }
+  inject_head = inject_tail = 0;
+  inject_ready = 1;
+}
+
+static int inject_put( wool_future_t *fut )
+{
+  unsigned long pos = inject_tail;
+  inject_cell_t *cell;
+
+  while( 1 ) {
+    long dif;
+
+    cell = inject_cells + ( pos & (WOOL_INJECT_QUEUE_SIZE-1) );
+    dif = (long) cell->seq - (long) pos;
+    if( dif == 0 ) {
+      if( __sync_bool_compare_and_swap( &inject_tail, pos, pos+1 ) ) {
+        break;
+      }
+    } else if( dif < 0 ) {
+      return 0; // Full
+    }
+    pos = inject_tail;
+  }
+  cell->fut = fut;
+  STORE_PTR_REL( cell->seq, pos+1 );
+  return 1;
+}
+
+static wool_future_t *inject_take( void )
+{
+  unsigned long pos = inject_head;
+  inject_cell_t *cell;
+  wool_future_t *fut;
+
+  while( 1 ) {
+    long dif;
+
+    cell = inject_cells + ( pos & (WOOL_INJECT_QUEUE_SIZE-1) );
+    dif = (long) READ_PTR_ACQ( cell->seq, unsigned long ) - (long) (pos+1);
+    if( dif == 0 ) {
+      if( __sync_bool_compare_and_swap( &inject_head, pos, pos+1 ) ) {
+        break;
+      }
+    } else if( dif < 0 ) {
+      return NULL; // Empty
+    }
+    pos = inject_head;
+  }
+  fut = cell->fut;
+  STORE_PTR_REL( cell->seq, pos + WOOL_INJECT_QUEUE_SIZE );
+  return fut;
+}
+
+static inline int inject_pending( void )
+{
+  return inject_head != inject_tail;
+}
+
+// A root task runs beside the main program, so it gets reducer views of
+// its own, like a stolen task. They are kept in the future until someone
+// waits for it.
+static void run_injected( Worker *self, wool_future_t *fut )
+{
+  void *views = self->pr.storage, *result;
+
+  #if WOOL_REDUCERS
+    self->pr.storage = &_WOOL_(no_views);
+  #endif
+  result = fut->fun( fut->arg );
+  #if WOOL_REDUCERS
+    fut->views = self->pr.storage == &_WOOL_(no_views) ? NULL : self->pr.storage;
+  #endif
+  self->pr.storage = views;
+
+  PR_INC( self, CTR_injected );
+  wool_lock( &(fut->lock) );
+  fut->result = result;
+  STORE_INT_REL( fut->done, 1 );
+  wool_broadcast( &(fut->cond) );
+  wool_unlock( &(fut->lock) );
+}
+
+// Called by an idle worker; the injected task becomes the root of a new
+// task tree, so the worker is a victim rather than a thief while running it.
+static int run_one_injected( Worker *self )
+{
+  wool_future_t *fut = inject_take();
+  int is_thief = self->pu.is_thief, flag = self->pu.flag;
+
+  if( fut == NULL ) {
+    return 0;
+  }
+  self->pu.flag = 0;
+  self->pu.is_thief = 0;
+  run_injected( self, fut );
+  self->pu.flag = flag;
+  self->pu.is_thief = is_thief;
+  return 1;
+}
+
+wool_future_t *wool_submit( workfun_t fun, void *arg )
+{
+  wool_future_t *fut;
+
+  if( !inject_ready ) {
+    fprintf( stderr, "wool_submit called before wool_init\n" );
+    exit( 1 );
+  }
+  fut = malloc( sizeof( wool_future_t ) );
+  if( fut == NULL ) {
+    return NULL;
+  }
+  fut->fun    = fun;
+  fut->arg    = arg;
+  fut->result = NULL;
+  #if WOOL_REDUCERS
+    fut->views = NULL;
+  #endif
+  fut->done   = 0;
+  pthread_mutex_init( &(fut->lock), NULL );
+  pthread_cond_init( &(fut->cond), NULL );
+
+  // A full queue means that all workers are busy; wait for one to take some.
+  while( !inject_put( fut ) ) {
+    sched_yield();
+  }
+  wake_one( _WOOL_(slow_get_self)() );
+  return fut;
+}
+
+#if WOOL_REDUCERS
+static void merge_leftmost( _wool_views_t * );
+#endif
+
+// The views of a finished root task are folded in once, by the first to
+// wait for it: into the waiter's views if it is a worker, as at a join,
+// and otherwise straight into the leftmost views. A thread that is not a
+// worker must therefore only wait for a task that used reducers while no
+// task updates the leftmost views of those reducers.
+static void collect_views( Worker *self, wool_future_t *fut )
+{
+  #if WOOL_REDUCERS
+    _wool_views_t *views;
+
+    wool_lock( &(fut->lock) );
+    views = fut->views;
+    fut->views = NULL;
+    wool_unlock( &(fut->lock) );
+    if( views == NULL ) {
+      return;
+    } else if( self != NULL ) {
+      _WOOL_(merge_views)( self, views );
+    } else {
+      merge_leftmost( views );
+    }
+  #endif
+}
+
+int wool_future_done( wool_future_t *fut )
+{
+  return READ_INT_ACQ( fut->done, int );
+}
+
+void *wool_future_wait( wool_future_t *fut )
+{
+  Worker *self = _WOOL_(slow_get_self)();
+
+  if( self != NULL ) {
+    // A worker helps out instead of blocking, like a worker that syncs
+    // with a stolen task; whatever it picks up runs on top of its pool.
+    int is_thief = self->pu.is_thief, flag = self->pu.flag;
+    unsigned int seed = self->pr.idx;
+
+    while( !READ_INT_ACQ( fut->done, int ) ) {
+      if( !run_one_injected( self ) && !steal_while_waiting( self, &seed ) ) {
+        sched_yield();
+      }
+    }
+    self->pu.flag = flag;
+    self->pu.is_thief = is_thief;
+  } else {
+    wool_lock( &(fut->lock) );
+    while( !fut->done ) {
+      wool_wait( &(fut->cond), &(fut->lock) );
+    }
+    wool_unlock( &(fut->lock) );
+  }
+  collect_views( self, fut );
+  return fut->result;
+}
+
+void wool_future_free( wool_future_t *fut )
+{
+  collect_views( _WOOL_(slow_get_self)(), fut );
+  pthread_mutex_destroy( &(fut->lock) );
+  pthread_cond_destroy( &(fut->cond) );
+  free( fut );
+}
+
 _wool_thread_local _WOOL_(key_t) tls_self;
 
 #define THIEF_IDX_BITS       12
@@ -216,7 +506,59 @@ _wool_thread_local _WOOL_(key_t) tls_self;
 #define INFO_GET_BASE(to)     ( ((unsigned long) (to)) >> THIEF_IDX_BITS )
 
 
-typedef enum { AA_HERE, AA_DIST } alloc_t;
+typedef enum { AA_HERE, AA_DIST, AA_LAZY } alloc_t;
+
+// On Linux, memory comes straight from mmap(). AA_HERE memory is placed on
+// the NUMA node of the calling worker and pre-faulted, so that the first
+// traversal of a pool block takes no page faults. AA_LAZY memory is also
+// node local, but only reserved; pages are committed as they are touched.
+// Huge pages are optional (-G): 1 asks for transparent huge pages and 2
+// for explicit ones (hugetlbfs), with a fallback to ordinary pages.
+
+static int huge_pages = 0;
+
+#define HUGE_PAGE_SIZE  (2*1024*1024)
+
+#if defined(__linux__) && !defined(__TILECC__)
+
+#define MPOL_PREFERRED_ 1 // From <numaif.h>, which is not always installed
+#define MAX_NODES       1024
+
+static int local_node( void );
+static int n_nodes = 1;
+
+static size_t alloc_size( size_t nbytes )
+{
+  return huge_pages == 2 ? ROUND( nbytes, (size_t) HUGE_PAGE_SIZE ) : nbytes;
+}
+
+static void bind_to_local_node( void *p, size_t size )
+{
+  unsigned long mask[ MAX_NODES / ( 8*sizeof(long) ) ];
+  int node = n_nodes > 1 ? local_node() : -1;
+
+  if( node < 0 || node >= MAX_NODES ) {
+    return;
+  }
+  memset( mask, 0, sizeof(mask) );
+  mask[ node / ( 8*sizeof(long) ) ] = 1UL << ( node % ( 8*sizeof(long) ) );
+  syscall( SYS_mbind, p, size, MPOL_PREFERRED_, mask, (unsigned long) MAX_NODES, 0 );
+}
+
+static void prefault( void *p, size_t size )
+{
+  static long page_size = 0;
+  char *q;
+
+  if( page_size == 0 ) {
+    page_size = sysconf( _SC_PAGESIZE );
+  }
+  for( q = (char *) p; q < (char *) p + size; q += page_size ) {
+    *(volatile char *) q = 0;
+  }
+}
+
+#endif
 
 static void *alloc_aligned( size_t nbytes, alloc_t  where )
 {
@@ -226,16 +568,71 @@ static void *alloc_aligned( size_t nbytes, alloc_t  where )
 
     switch( where ) {
       case AA_HERE: m = ALLOC_HOME_TASK; break;
+      case AA_LAZY: m = ALLOC_HOME_TASK; break;
       case AA_DIST: m = ALLOC_HOME_HASH; break;
     }
 
     alloc_set_home( &attr, m );
     return alloc_map( &attr, nbytes );
+  #elif defined(__linux__)
+    size_t size = alloc_size( nbytes );
+    void *p = MAP_FAILED;
+
+    if( huge_pages == 2 ) {
+      p = mmap( NULL, size, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0 );
+    }
+    if( p == MAP_FAILED ) {
+      p = mmap( NULL, size, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS | ( where == AA_LAZY ? MAP_NORESERVE : 0 ), -1, 0 );
+    }
+    if( p == MAP_FAILED ) {
+      return NULL;
+    }
+    if( huge_pages == 1 ) {
+      madvise( p, size, MADV_HUGEPAGE );
+    }
+    if( where != AA_DIST ) {
+      bind_to_local_node( p, size );
+    }
+    if( where == AA_HERE ) {
+      prefault( p, size );
+    }
+    return p;
   #else
     return valloc( nbytes );
   #endif
 }
 
+static void free_aligned( void *p, size_t nbytes )
+{
+  #if defined(__TILECC__)
+    alloc_unmap( p, nbytes );
+  #elif defined(__linux__)
+    munmap( p, alloc_size( nbytes ) );
+  #else
+    free( p );
+  #endif
+}
+
+// Give the pages back to the OS but keep the mapping, so a late reader
+// sees zeroes rather than a fault. The memory must be reinitialized before
+// it is used again.
+
+static void discard_aligned( void *p, size_t nbytes )
+{
+  #if defined(__linux__) && !defined(__TILECC__)
+    if( nbytes > 0 ) {
+      madvise( p, nbytes, MADV_DONTNEED );
+    }
+  #endif
+}
+
+#if WOOL_STEAL_BOARD
+static volatile unsigned char *steal_board; // One byte per worker, see board_mark()
+static int board_in_use = 0;
+#endif
+
 static void make_common_data( int n )
 {
   void *block;
@@ -247,6 +644,14 @@ static void make_common_data( int n )
   }
   workers     = (Worker **) (block);
   bases       = (Task **) (block + n*sizeof(void *));
+  #if WOOL_STEAL_BOARD
+    // Zeroed, and on lines of its own
+    steal_board = (volatile unsigned char *) alloc_aligned( ROUND( n, LINE_SIZE ), AA_DIST );
+    if( steal_board == NULL ) {
+      fprintf( stderr, "Out of memory" );
+      exit( 1 );
+    }
+  #endif
 }
 
 static int global_pref_dist = 0;
@@ -279,7 +684,7 @@ static wool_lock_t more_lock = PTHREAD_MUTEX_INITIALIZER;
 
 static wool_cond_t sleep_cond;
 static wool_lock_t sleep_lock = PTHREAD_MUTEX_INITIALIZER;
-static int old_thieves = 0, max_old_thieves = -1;
+static int old_thieves = 0, max_old_thieves = -1, max_old_thieves_option = -1;
 
 static pthread_attr_t worker_attr;
 
@@ -870,7 +1275,7 @@ static int new_old_thief( Worker *self )
 
   wool_lock( &sleep_lock );
   if( old_thieves >= max_old_thieves + 2 ) {
-    while( self->pr.more_work && old_thieves >= max_old_thieves + 2 ) {
+    while( self->pr.more_work > 1 && old_thieves >= max_old_thieves + 2 ) {
       wool_wait( &sleep_cond, &sleep_lock );
     }
     is_old = 0;
@@ -896,124 +1301,368 @@ static void decrement_old_thieves(void)
   }
 }
 
-#define LARGE_POINTER    ((Task *) -1024L)
+// Parking of idle workers
+//
+// A worker that has failed to find work for park_interval rounds parks on
+// an eventcount (park_seq) using a futex. Before parking it announces
+// itself in n_parked and then looks once more for work, so a waker that
+// publishes work and then sees n_parked == 0 knows that the parker will
+// find it. Wakers only touch park_seq and make the system call when there
+// are parked workers. Since public spawns do not synchronize, parking has
+// a timeout and the parker asks the workers that are not parked to take
+// the slow path on their next spawn, where sleepers are woken. A worker
+// that times out without finding work parks again at once, with twice
+// the timeout, up to park_timeout_max, so an idle worker stays asleep
+// and disturbs the busy ones less and less often.
+
+static volatile int park_seq __attribute__((aligned(LINE_SIZE))) = 0;
+static volatile int n_parked __attribute__((aligned(LINE_SIZE))) = 0;
+static int park_interval = 20000;  // Fruitless rounds before parking, set by '-P'
+static int park_timeout  = 1000;   // First park in microseconds, set by '-T'
+static int park_timeout_max = 64000; // Longest park in microseconds
+#if COUNT_EVENTS
+static volatile long long unsigned last_wake_ns = 0;
 
-#if WOOL_JOIN_STACK
+static long long unsigned ns_now( void )
+{
+  struct timespec t;
 
-Task *_WOOL_(dummy_task_ptr) = NULL; // A task address that is neither NULL nor in any pool
+  clock_gettime( CLOCK_MONOTONIC, &t );
+  return t.tv_sec * 1000000000LL + t.tv_nsec;
+}
+#endif
 
-#define log_first_block_size 9
-#define     first_block_size (1 << log_first_block_size)
+static void futex_wait( volatile int *addr, int val, int timeout_us )
+{
+  struct timespec t;
 
-/* static */ unsigned block_size( int i )
+  t.tv_sec  = timeout_us / 1000000;
+  t.tv_nsec = ( timeout_us % 1000000 ) * 1000;
+  #if defined(__linux__)
+    syscall( SYS_futex, addr, FUTEX_WAIT_PRIVATE, val, &t, NULL, 0 );
+  #else
+    if( *addr == val ) {
+      nanosleep( &t, NULL );
+    }
+  #endif
+}
+
+static void futex_wake( volatile int *addr, int n )
 {
-  return first_block_size;
+  #if defined(__linux__)
+    syscall( SYS_futex, addr, FUTEX_WAKE_PRIVATE, n, NULL, NULL, 0 );
+  #endif
 }
 
-static unsigned long start_idx_of_block( Worker *self, int i )
+#if WOOL_ASYM_FENCE
+
+// Nonzero when the kernel runs membarrier() for us; read by OWNER_FENCE
+int _WOOL_(asym_fences) = 0;
+
+static void asym_fence_init( void )
 {
-  unsigned long base = self->pr.pool_base_idx;
-  unsigned long base_bidx = (base / first_block_size) & (_WOOL_pool_blocks-1);
-  int ri = (i - base_bidx) & (_WOOL_pool_blocks-1);
-  return base + ri * first_block_size;
+  _WOOL_(asym_fences) =
+    syscall( SYS_membarrier, MEMBARRIER_CMD_REGISTER_PRIVATE_EXPEDITED, 0, 0 ) == 0;
+  if( !_WOOL_(asym_fences) ) {
+    fprintf( stderr, "Wool: membarrier() is not available, using MFENCE\n" );
+  }
 }
 
-static inline int block_of_idx( Worker *self, unsigned long t )
+// The other half of OWNER_FENCE. Stores made by the caller before it are
+// visible to every owner's loads after its next OWNER_FENCE, and every
+// store an owner made before its last OWNER_FENCE is visible to the
+// caller's loads after it.
+
+static void thief_fence( void )
 {
-  return (t / first_block_size) % _WOOL_pool_blocks;
+  if( _WOOL_(asym_fences) ) {
+    syscall( SYS_membarrier, MEMBARRIER_CMD_PRIVATE_EXPEDITED, 0, 0 );
+  } else {
+    MFENCE;
+  }
 }
 
 #else
 
-#define log_first_block_size 8
-#define     first_block_size (1 << log_first_block_size)
+#define asym_fence_init() /* Nothing */
 
-/* static */ unsigned block_size( int i )
+#endif
+
+static void wake_one( Worker *self )
 {
-  return first_block_size * (1<<i);
+  if( WOOL_IDLE_PARK && n_parked > 0 ) {
+    #if COUNT_EVENTS
+      last_wake_ns = ns_now();
+      if( self != NULL ) {
+        PR_INC( self, CTR_wakes );
+      }
+    #endif
+    __sync_fetch_and_add( &park_seq, 1 );
+    futex_wake( &park_seq, 1 );
+  }
 }
 
-static unsigned long start_idx_of_block( Worker *self, int i )
+static void wake_all( void )
 {
-  return block_size(i) - first_block_size;
+  __sync_fetch_and_add( &park_seq, 1 );
+  futex_wake( &park_seq, INT_MAX );
 }
 
-#if !defined(WOOL_NO_CLZ)
+#if WOOL_REDUCERS
 
-static inline int block_of_idx( Worker *self, unsigned long t )
+// Reducers get an index into the view tables the first time a stolen
+// task asks for a view; the leftmost views need none. The index is held
+// until wool_reducer_retire() gives it back for reuse.
+
+_wool_views_t _WOOL_(no_views);
+
+static wool_reducer_t *reducers[ WOOL_MAX_REDUCERS ];
+static volatile int    n_reducers = 0;
+static wool_lock_t     reducer_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void register_reducer( wool_reducer_t *r )
 {
-  int fblz = 8*sizeof(unsigned long) - log_first_block_size - 1;
+  wool_lock( &reducer_lock );
+  if( r->id == 0 ) {
+    int i = 0;
 
-  return fblz - __builtin_clzl( t + first_block_size );
+    while( i < n_reducers && reducers[i] != NULL ) {
+      i++;
+    }
+    if( i >= WOOL_MAX_REDUCERS ) {
+      fprintf( stderr, "Too many reducers in use, at most %d\n", WOOL_MAX_REDUCERS );
+      exit( 1 );
+    }
+    reducers[i] = r;
+    if( i == n_reducers ) {
+      n_reducers++;
+    }
+    SFENCE;
+    r->id = i+1;
+  }
+  wool_unlock( &reducer_lock );
 }
 
-#else
+void wool_reducer_retire( wool_reducer_t *r )
+{
+  wool_lock( &reducer_lock );
+  if( r->id > 0 ) {
+    reducers[ r->id-1 ] = NULL;
+    r->id = 0;
+  }
+  wool_unlock( &reducer_lock );
+}
 
-static int block_of_idx( Worker *self, unsigned long t )
+void *_WOOL_(new_view)( Worker *self, wool_reducer_t *r )
 {
-  if( t < first_block_size ) {
-    return 0;
-  } else {
-    int lo=0, hi=_WOOL_pool_blocks;
+  _wool_views_t *v = (_wool_views_t *) self->pr.storage;
+  void *view;
 
-    while( hi-lo>1 ) {
-      int m = (hi+lo)/2;
-      if( t < start_idx_of_block( self, m ) ) {
-        hi = m;
-      } else {
-        lo = m;
-      }
+  if( r->id == 0 ) {
+    register_reducer( r );
+  }
+  if( v == &_WOOL_(no_views) ) {
+    v = (_wool_views_t *) calloc( 1, sizeof(_wool_views_t) );
+    if( v == NULL ) {
+      fprintf( stderr, "Out of memory for reducer views\n" );
+      exit( 1 );
     }
-    return lo;
+    self->pr.storage = v;
+  }
+  view = malloc( r->size );
+  if( view == NULL ) {
+    fprintf( stderr, "Out of memory for reducer views\n" );
+    exit( 1 );
   }
+  r->identity( view );
+  v->view[ r->id-1 ] = view;
+  return view;
 }
 
-#endif
+// Called at the join with a stolen task, or one run by its spawn, that
+// created views; they come to the right of the joiner's own.
+void _WOOL_(merge_views)( Worker *self, _wool_views_t *right )
+{
+  _wool_views_t *left = (_wool_views_t *) self->pr.storage;
+  int i, n = n_reducers;
 
-#endif
+  if( left == &_WOOL_(no_views) ) {
+    self->pr.storage = right;
+    return;
+  }
+  for( i = 0; i < n; i++ ) {
+    if( right->view[i] != NULL ) {
+      if( left != NULL && left->view[i] == NULL ) {
+        left->view[i] = right->view[i];
+      } else {
+        wool_reducer_t *r = reducers[i];
+        r->reduce( _WOOL_(reducer_view)( self, r ), right->view[i] );
+        free( right->view[i] );
+      }
+    }
+  }
+  free( right );
+}
 
-// Currently unused
-#if 0
-static int block_of_ptr( Worker *w, Task *t )
+// Folds the views of a root task into the leftmost ones, see collect_views()
+static void merge_leftmost( _wool_views_t *right )
 {
-  int i;
+  int i, n = n_reducers;
 
-  for( i = 0; i < _WOOL_pool_blocks; i++ ) {
-    if( (unsigned long) (t - w->pr.block_base[i]) < block_size(i) ) {
-      return i;
+  for( i = 0; i < n; i++ ) {
+    if( right->view[i] != NULL ) {
+      reducers[i]->reduce( reducers[i]->leftmost, right->view[i] );
+      free( right->view[i] );
     }
   }
-  return -1;
+  free( right );
 }
-#endif
 
-inline TILE_INLINE unsigned long ptr2idx_curr( Worker *w, Task *t )
+// Runs a stolen task with no views of its own, and leaves the views it
+// created in the (possibly moved) descriptor for the joiner.
+static inline Task *run_stolen( Worker *self, Task *tp, _wool_task_header_t f )
 {
-  Task *base = w->pr.curr_block_base;
-  assert( t != NULL );
-  assert( t >= base );
-  assert( t < base + block_size(w->pr.t_idx) );
-  return w->pr.curr_block_fidx + t - base;
+  void *views = self->pr.storage;
+  Task *ntp;
+
+  self->pr.storage = &_WOOL_(no_views);
+  ntp = f->f( self, tp );
+  ( (_WOOL_(StolenTask) *) ntp )->info.views =
+    self->pr.storage == &_WOOL_(no_views) ? NULL : self->pr.storage;
+  self->pr.storage = views;
+  return ntp;
 }
 
-// Currently unused
-#if 0
-static Task *idx2ptr_curr( Worker *w, unsigned long t )
+static inline int has_views( _WOOL_(StolenTask) *t )
 {
-  Task **blocks = &(w->pr.block_base[0]);
-  int    idx = w->pr.t_idx;
-  return blocks[idx] + t - start_idx_of_block(w, idx);
+  return t->info.views != NULL;
 }
-#endif
 
-// Compute the size of the public tasks in a block, possibly except the last one
-// If this value is n, then
-//   low          = base+n
-//   private_size = sizeof(Task) * (block_size-1-n)
-static unsigned long new_local_public_size( Worker *self, int t_idx, unsigned long n_public )
+#else
+
+static inline Task *run_stolen( Worker *self, Task *tp, _wool_task_header_t f )
+{
+  return f->f( self, tp );
+}
+
+static inline int has_views( _WOOL_(StolenTask) *t )
+{
+  return 0;
+}
+
+#endif
+
+#define LARGE_POINTER    ((Task *) -1024L)
+
+#if WOOL_JOIN_STACK
+
+Task *_WOOL_(dummy_task_ptr) = NULL; // A task address that is neither NULL nor in any pool
+
+#define log_first_block_size 9
+#define     first_block_size (1 << log_first_block_size)
+
+/* static */ unsigned block_size( int i )
+{
+  return first_block_size;
+}
+
+static unsigned long start_idx_of_block( Worker *self, int i )
+{
+  unsigned long base = self->pr.pool_base_idx;
+  unsigned long base_bidx = (base / first_block_size) & (self->pr.n_blocks-1);
+  int ri = (i - base_bidx) & (self->pr.n_blocks-1);
+  return base + ri * first_block_size;
+}
+
+static inline int block_of_idx( Worker *self, unsigned long t )
+{
+  return (t / first_block_size) % self->pr.n_blocks;
+}
+
+#else
+
+#define log_first_block_size 8
+#define     first_block_size (1 << log_first_block_size)
+
+/* static */ unsigned block_size( int i )
+{
+  return first_block_size * (1<<i);
+}
+
+static unsigned long start_idx_of_block( Worker *self, int i )
+{
+  return block_size(i) - first_block_size;
+}
+
+#if !defined(WOOL_NO_CLZ)
+
+static inline int block_of_idx( Worker *self, unsigned long t )
+{
+  int fblz = 8*sizeof(unsigned long) - log_first_block_size - 1;
+
+  return fblz - __builtin_clzl( t + first_block_size );
+}
+
+#else
+
+// Block sizes double, so this takes a logarithmic number of steps without
+// looking at the number of blocks, which only the owner may read.
+static int block_of_idx( Worker *self, unsigned long t )
+{
+  int i = 0;
+
+  while( t >= start_idx_of_block( self, i+1 ) ) {
+    i++;
+  }
+  return i;
+}
+
+#endif
+
+#endif
+
+// Currently unused
+#if 0
+static int block_of_ptr( Worker *w, Task *t )
+{
+  int i;
+
+  for( i = 0; i < w->pr.n_blocks; i++ ) {
+    if( (unsigned long) (t - w->pr.block_base[i]) < block_size(i) ) {
+      return i;
+    }
+  }
+  return -1;
+}
+#endif
+
+inline TILE_INLINE unsigned long ptr2idx_curr( Worker *w, Task *t )
+{
+  Task *base = w->pr.curr_block_base;
+  assert( t != NULL );
+  assert( t >= base );
+  assert( t < base + block_size(w->pr.t_idx) );
+  return w->pr.curr_block_fidx + t - base;
+}
+
+// Currently unused
+#if 0
+static Task *idx2ptr_curr( Worker *w, unsigned long t )
+{
+  Task **blocks = &(w->pr.block_base[0]);
+  int    idx = w->pr.t_idx;
+  return blocks[idx] + t - start_idx_of_block(w, idx);
+}
+#endif
+
+// Compute the size of the public tasks in a block, possibly except the last one
+// If this value is n, then
+//   low          = base+n
+//   private_size = sizeof(Task) * (block_size-1-n)
+static unsigned long new_local_public_size( Worker *self, int t_idx, unsigned long n_public )
 {
   unsigned long this_base_idx = start_idx_of_block( self, t_idx ),
-                next_base_idx = start_idx_of_block( self, (t_idx+1) % _WOOL_pool_blocks );
+                next_base_idx = start_idx_of_block( self, (t_idx+1) % self->pr.n_blocks );
 
   if( n_public < this_base_idx ) {
     return 0;
@@ -1026,10 +1675,14 @@ static unsigned long new_local_public_size( Worker *self, int t_idx, unsigned lo
 
 #if WOOL_JOIN_STACK
 
+// A thief reads the public block table once, so the size and the block
+// pointers it uses agree even if the owner grows the pool meanwhile. The
+// owner publishes a new table with a release store, see grow_block_table().
+
 static inline Task *idx_to_task_p_pu( Worker *w, unsigned long t, Task *b )
 {
-  int bidx = (t / first_block_size) % _WOOL_pool_blocks;
-  Task *block = w->pu.pu_block_base[bidx];
+  _WOOL_(BlockTable) *bt = READ_PTR_ACQ( w->pu.pu_blocks, _WOOL_(BlockTable) * );
+  Task *block = bt->block[ (t / first_block_size) & (bt->n_blocks-1) ];
 
   return block == NULL ? NULL : block + t % first_block_size;
 }
@@ -1038,14 +1691,19 @@ static inline Task *idx_to_task_p_pu( Worker *w, unsigned long t, Task *b )
 
 static inline Task *idx_to_task_p_pu( Worker *w, unsigned long t, Task *b )
 {
+  _WOOL_(BlockTable) *bt;
   int bidx;
   Task *bb;
 
   if( t < first_block_size ) {
     return b+t;
   }
+  bt = READ_PTR_ACQ( w->pu.pu_blocks, _WOOL_(BlockTable) * );
   bidx = block_of_idx( w, t );
-  bb = w->pu.pu_block_base[bidx];
+  if( bidx >= bt->n_blocks ) {
+    return NULL;
+  }
+  bb = bt->block[bidx];
   return bb==NULL ? NULL : bb + ( t - start_idx_of_block( w, bidx ) );
 }
 
@@ -1078,6 +1736,104 @@ static void throw_both_exceptions(Worker *w)
   throw_spawn_exception( w );
 }
 
+#if WOOL_STEAL_BOARD
+
+// The steal board summarizes which workers are worth a steal attempt, so
+// that thieves using it read a few shared lines rather than the pools of
+// all workers. A worker marks its byte at slow spawns and when it makes
+// more tasks public, which is cheap since the byte is only written when
+// it changes. A thief that finds a marked worker without work clears the
+// byte and throws a spawn exception at the worker, so that its next spawn
+// is slow and marks the byte again. The board is only a hint; thieves
+// fall back on the ordinary search when it is empty.
+
+static inline void board_mark( Worker *w )
+{
+  if( board_in_use && !steal_board[ w->pr.idx ] ) {
+    steal_board[ w->pr.idx ] = 1;
+  }
+}
+
+static inline void board_clear( Worker *w )
+{
+  if( steal_board[ w->pr.idx ] ) {
+    steal_board[ w->pr.idx ] = 0;
+    throw_spawn_exception( w );
+  }
+}
+
+#else
+
+#define board_mark( w ) /* Empty */
+
+#endif
+
+#if WOOL_RECV_INIT
+
+/*
+  Receiver initiated stealing keeps the whole pool private, so no spawn
+  or sync of an unstolen task uses an atomic instruction. A thief asks a
+  victim for work by writing its index into the request cell of the victim
+  and throwing both exceptions at it. The victim answers at its next slow
+  spawn or sync, or from its own steal loop, by handing over the oldest
+  task in its pool. The victim marks that task as stolen on behalf of the
+  thief and moves dq_bot and n_public past it, so the join takes the
+  ordinary path through rts_sync(). Both parties claim the request cell by
+  compare and swap; a thief that gets no answer in time withdraws its
+  request unless the victim has already claimed it.
+*/
+
+static Task ri_no_task; // The answer when the victim has nothing to hand over
+
+#define ri_pending( w ) ( (w)->pu.ri_request != 0 )
+
+// Called by the owner; tasks from dq_bot up to but not including limit may
+// be handed over.
+
+static void ri_answer( Worker *self, unsigned long limit )
+{
+  int r = self->pu.ri_request;
+  unsigned long bot = self->pu.dq_bot;
+  Worker *thief;
+  Task *tp = NULL, *jt;
+  _wool_task_header_t f = NULL;
+
+  if( r == 0 || !__sync_bool_compare_and_swap( &( self->pu.ri_request ), r, 0 ) ) {
+    return;
+  }
+  thief = workers[r-1];
+  jt = thief->pu.ri_join;
+  // A leapfrogging thief may only have tasks spawned by the one it joins with
+  if( bot < limit && ( jt == NULL || jt->hdr != SFS_DONE ) ) {
+    tp = idx_to_task_p( self, bot );
+  }
+  if( tp != NULL && SFS_IS_TASK( f = tp->hdr ) ) {
+    #if WOOL_JOIN_STACK
+      tp->join_data.back_link = NULL;
+    #endif
+    #if WOOL_TRLF
+      tp->ssn++;
+    #endif
+    tp->hdr = thief->pu.ri_card;
+    self->pu.dq_bot = bot+1;
+    self->pr.n_public = bot+1;
+    self->pu.pu_n_public = bot+1;
+    thief->pu.ri_f = f;
+    // The derived values follow n_public at the next slow spawn or sync
+    throw_both_exceptions( self );
+  } else {
+    tp = &ri_no_task;
+  }
+  STORE_PTR_REL( thief->pu.ri_reply, tp );
+}
+
+#else
+
+#define ri_pending( w ) 0
+#define ri_answer( w, limit ) /* Empty */
+
+#endif
+
 // Adjusting the number of stealable tasks
 
 /*
@@ -1185,7 +1941,9 @@ static void more_stealable( Worker *w, unsigned long p_idx )
   }
 
   PR_INC( w, CTR_add_stealable );
+  board_mark( w );
 
+  wake_one( w );
 }
 
 static inline int maybe_more_stealable( Worker *self, unsigned long p_idx )
@@ -1220,7 +1978,7 @@ static void less_stealable(Worker *self, Task *q )
   long unsigned top_idx = ptr2idx_curr( self, q );
   long unsigned curr = self->pr.n_public,
                 next,i;
-  long unsigned high;
+  long unsigned high, bot;
 
   /* We can only privatize empty task descriptors
      q (and top_idx) is the lowest guaranteed empty one (top_idx is one above the idx of the
@@ -1230,7 +1988,8 @@ static void less_stealable(Worker *self, Task *q )
   */
 
   high = self->pr.highest_bot;
-  high = high < self->pu.dq_bot ? self->pu.dq_bot : self->pr.highest_bot;
+  bot  = _WOOL_BOT_IDX( self->pu.dq_bot );
+  high = high < bot ? bot : self->pr.highest_bot;
   self->pr.highest_bot = 0;
 
   if( curr <= top_idx + steal_margin || curr <= high ) {
@@ -1271,7 +2030,11 @@ maybe_request_stealable( Worker *victim, unsigned long b_idx, unsigned long pub
     #if 1 && WOOL_ADD_STEALABLE
     if( b_idx >= pub-1 ) {
       victim->pr.more_public_wanted = 1;
-      SFENCE;
+      #if WOOL_ASYM_FENCE
+        thief_fence(); // The victim may be between reset_all_derived()'s stores and its test
+      #else
+        SFENCE;
+      #endif
       throw_both_exceptions( victim );
     }
     #endif
@@ -1328,13 +2091,15 @@ static void reset_all_derived( Worker *w, int maybe_skip )
   unsigned long bsize = block_size(idx);
   unsigned long pub   = new_local_public_size( w, idx, w->pr.n_public );
   Task         *jfp   = base + ( pub / sizeof(Task) );
+  // With private pools, joins with handed over tasks go to slow_sync() without a grab
+  unsigned long psz   = WOOL_RECV_INIT ? 0 : pub;
   #if _WOOL_ordered_stores
     Task *sph = base + bsize - 1;
   #else
     unsigned long ps = sizeof(Task) * ( bsize-1 ) - pub;
   #endif
 
-  if( maybe_skip && w->pr.public_size == pub && w->pr.join_first_private == jfp &&
+  if( maybe_skip && w->pr.public_size == psz && w->pr.join_first_private == jfp &&
   #if _WOOL_ordered_stores
     w->pr.spawn_high == sph
   #else
@@ -1344,7 +2109,7 @@ static void reset_all_derived( Worker *w, int maybe_skip )
     return;
   }
 
-  w->pr.public_size = pub;
+  w->pr.public_size = psz;
   w->pr.join_first_private = jfp;
   #if _WOOL_ordered_stores
     w->pr.spawn_high = sph;
@@ -1352,16 +2117,36 @@ static void reset_all_derived( Worker *w, int maybe_skip )
     w->pr.private_size = ps;
     w->pr.spawn_first_private = jfp;
   #endif
-  MFENCE;
-  if( w->pr.more_public_wanted ) {
+  OWNER_FENCE;
+  if( w->pr.more_public_wanted || ri_pending( w ) ) {
     throw_both_exceptions( w );
   } else if( w->pr.decrement_deferred ) {
     throw_spawn_exception( w );
   }
 }
 
+static size_t spill_size = 16*1024*1024; // Bytes, reserved but committed on use
+
+// The spill arena starts with a zeroed guard, see _WOOL_(spawn_lazy)
+static inline char *spill_base( Worker *w )
+{
+  return w->pr.spill_end - spill_size;
+}
+
+static inline int spill_empty( Worker *w )
+{
+  return w->pr.spill_top == spill_base( w ) + _WOOL_SPILL_ALIGN;
+}
+
 #if WOOL_JOIN_STACK
 
+// Unlinks the descriptors of done tasks that return nothing, which joins
+// treat as absent anyway. This is a scan of the join stack, but it is not
+// on any regular path: a slot is freed in O(1) when its task is joined,
+// so js_alloc() only gets here when all of the reserved join stack holds
+// unjoined tasks. Freeing done slots earlier would mean a second list
+// that thieves push to while the owner pops joined slots off the join
+// stack, which costs every join with a stolen task a synchronization.
 static void compact_join_stack( Worker *self )
 {
   _WOOL_(StolenTask) *t, *first = NULL, **prev_p = &first, *next,
@@ -1372,7 +2157,7 @@ static void compact_join_stack( Worker *self )
 
   for( t = self->pr.join_stack_top; t != NULL; t = next ) {
     next = t->info.next;
-    if( t->hdr != SFS_DONE || t->info.size > 0 ) {
+    if( t->hdr != SFS_DONE || t->info.size > 0 || has_views( t ) ) {
       *prev_p = t;
        prev_p = &(t->info.next);
     } else {
@@ -1385,10 +2170,32 @@ static void compact_join_stack( Worker *self )
   self->pr.join_stack_free = jsfree;
 }
 
+// The join stack is reserved but not committed at init. Slots come from
+// the free list of joined slots, then from never used memory above the
+// bump pointer, and only when both are used up from compacting the join
+// stack, see compact_join_stack().
+// When the join stack is empty, every slot is free, so we start over from
+// the bottom and keep the touched part small.
+
 static inline _WOOL_(StolenTask) *js_alloc( Worker *self )
 {
   _WOOL_(StolenTask) *t;
+
+  if( self->pr.join_stack_top == NULL ) {
+    self->pr.join_stack_free = NULL;
+    self->pr.join_stack_bump = (_WOOL_(StolenTask) *) self->pr.join_stack_base;
+  }
   if( self->pr.join_stack_free == NULL ) {
+    if( self->pr.join_stack_bump < self->pr.join_stack_end ) {
+      t = self->pr.join_stack_bump;
+      self->pr.join_stack_bump = (_WOOL_(StolenTask) *) ( (Task *) t + 1 );
+      if( self->pr.join_stack_bump > self->pr.join_stack_hwm ) {
+        self->pr.join_stack_hwm = self->pr.join_stack_bump;
+        PR_MAX( self, CTR_js_hwm_kb,
+                ( (char *) self->pr.join_stack_hwm - (char *) self->pr.join_stack_base ) / 1024 );
+      }
+      return t;
+    }
     compact_join_stack( self );
     if( self->pr.join_stack_free == NULL ) {
       // We did not recover anything
@@ -1409,9 +2216,21 @@ static inline int is_stolen( Task *t )
   return !SFS_IS_TASK( t->hdr );
 }
 
+// The oldest block goes to the join stack once all its tasks are stolen,
+// unless it is the current one. With WOOL_LAZY_SPAWN, frame markers on
+// the spill arena hold descriptor addresses, so none may be reused while
+// the arena is in use.
+static int can_evacuate( Worker *self, int base_bidx, int idx )
+{
+  if( WOOL_LAZY_SPAWN && !spill_empty( self ) ) {
+    return 0;
+  }
+  return base_bidx != idx && is_stolen( self->pr.block_base[base_bidx] + first_block_size - 1 );
+}
+
 static Task* evacuate_oldest_block( Worker *self, unsigned long new_base_idx )
 {
-  int bidx = (self->pr.pool_base_idx / first_block_size) % _WOOL_pool_blocks;
+  int bidx = (self->pr.pool_base_idx / first_block_size) % self->pr.n_blocks;
   Task *block = self->pr.block_base[bidx];
   unsigned long join_top_idx = self->pr.join_stack_top_idx;
   int public_tasks = self->pr.n_public - new_base_idx;
@@ -1426,9 +2245,9 @@ static Task* evacuate_oldest_block( Worker *self, unsigned long new_base_idx )
     if( curr->join_data.back_link == &_WOOL_(dummy_task_ptr) ) {
       // Thief got here first; wait for it to write DONE and then copy
       while( curr->hdr != SFS_DONE ) WOOL_WAIT_CHECK(w) ;
-      if( curr->info.size > 0 ) {
+      if( curr->info.size > 0 || has_views( curr ) ) {
         _WOOL_(StolenTask) *t = js_alloc( self );
-        memcpy( t, curr, curr->info.size ); // Or a Task assignment?
+        memcpy( t, curr, curr->info.size > 0 ? curr->info.size : (int) sizeof(_WOOL_(StolenTask)) );
         t->join_data.task_index = join_top_idx + i;
         t->info.next = self->pr.join_stack_top;
         self->pr.join_stack_top = t;
@@ -1450,12 +2269,13 @@ static Task* evacuate_oldest_block( Worker *self, unsigned long new_base_idx )
     curr->balarm = _WOOL_ordered_stores && i < public_tasks ? TF_FREE : TF_OCC;
   }
   self->pr.join_stack_top_idx = join_top_idx + first_block_size;
+  self->pr.pool_base_idx += first_block_size;
   return block;
 }
 
 #else
 
-static inline int is_stolen( Task *t )
+static int can_evacuate( Worker *self, int base_bidx, int idx )
 {
   return 0;
 }
@@ -1466,6 +2286,156 @@ static Task* evacuate_oldest_block( Worker *self, unsigned long new_base_idx )
 }
 #endif
 
+// Called when every block is in use; doubles the number of blocks. With the
+// join stack, blocks form a ring indexed by task index modulo the number of
+// blocks, so each block moves to its slot in the larger ring. Thieves may
+// still hold the old public table; it goes on describing the blocks it used
+// to, and the new block is only published in the new table. Old tables are
+// kept until no thief can hold them, see free_older_tables(); as tables
+// double, they take less room than the current one meanwhile.
+
+static void grow_block_table( Worker *self )
+{
+  int n = self->pr.n_blocks, m = 2*n, i, t_idx = self->pr.t_idx;
+  Task **blocks = malloc( m * sizeof(Task *) );
+  _WOOL_(BlockTable) *pub = malloc( sizeof(_WOOL_(BlockTable)) + m * sizeof(Task *) );
+
+  if( blocks == NULL || pub == NULL || m > INT_MAX / 2 ) {
+    fprintf( stderr, "Out of space for task stack\n" );
+    exit( 1 );
+  }
+  for( i = 0; i < m; i++ ) {
+    blocks[i] = NULL;
+  }
+  for( i = 0; i < n; i++ ) {
+    int j = WOOL_JOIN_STACK ? (int) ( ( start_idx_of_block( self, i ) / first_block_size ) % m ) : i;
+
+    blocks[j] = self->pr.block_base[i];
+    if( i == self->pr.t_idx ) {
+      t_idx = j;
+    }
+  }
+  free( self->pr.block_base );
+  self->pr.block_base = blocks;
+  self->pr.n_blocks = m;
+  self->pr.t_idx = t_idx;
+  self->pr.spare_blocks = realloc( self->pr.spare_blocks, m * sizeof(Task *) );
+  if( !WOOL_JOIN_STACK ) {
+    for( i = n; i < m; i++ ) {
+      self->pr.spare_blocks[i] = NULL;
+    }
+  }
+
+  pub->n_blocks = m;
+  pub->older = self->pu.pu_blocks;
+  for( i = 0; i < m; i++ ) {
+    pub->block[i] = blocks[i];
+  }
+  STORE_PTR_REL( self->pu.pu_blocks, pub );
+  PR_INC( self, CTR_pool_grown );
+}
+
+// Only called when nobody steals, that is, with the pool suspended or shut
+// down.
+static void free_older_tables( Worker *w )
+{
+  _WOOL_(BlockTable) *bt, *older;
+
+  for( bt = w->pu.pu_blocks->older; bt != NULL; bt = older ) {
+    older = bt->older;
+    free( bt );
+  }
+  w->pu.pu_blocks->older = NULL;
+}
+
+#if WOOL_JOIN_STACK
+static int join_stack_size = 1024*1024;
+#endif
+
+// The block holding the oldest task in the pool
+static inline int base_block( Worker *w )
+{
+#if WOOL_JOIN_STACK
+  return (w->pr.pool_base_idx / first_block_size) % w->pr.n_blocks;
+#else
+  return 0;
+#endif
+}
+
+// With the join stack, all blocks have the same size and the spare blocks
+// form a stack. Otherwise block i can only be used as block i again, so
+// spare_blocks[i] holds it, or NULL.
+
+static void put_spare( Worker *w, int i, Task *b )
+{
+#if WOOL_JOIN_STACK
+  w->pr.spare_blocks[ w->pr.n_spare++ ] = b;
+#else
+  w->pr.spare_blocks[i] = b;
+  w->pr.n_spare++;
+#endif
+}
+
+static Task *get_spare( Worker *w, int i )
+{
+  Task *b = NULL;
+
+  if( w->pr.n_spare > 0 ) {
+#if WOOL_JOIN_STACK
+    b = w->pr.spare_blocks[ --w->pr.n_spare ];
+#else
+    b = w->pr.spare_blocks[i];
+    if( b != NULL ) {
+      w->pr.spare_blocks[i] = NULL;
+      w->pr.n_spare--;
+    }
+#endif
+  }
+  return b;
+}
+
+// Return the memory of an idle worker to the OS. Blocks outside the part
+// of the pool that is in use leave the block table for the spare list, and
+// their pages are discarded; slow_spawn reinitializes a spare block before
+// reusing it. A thief holding a stale block pointer reads zeroes there, and
+// backs out since the task index it wants is no longer dq_bot. An empty
+// join stack and an empty spill arena are discarded as well.
+
+static void trim_worker( Worker *w )
+{
+  int n = w->pr.n_blocks, i;
+  int base_bidx = base_block( w );
+  int in_use = ( w->pr.t_idx - base_bidx ) & (n-1);
+
+  for( i = 0; i < n; i++ ) {
+    Task *b = w->pr.block_base[i];
+
+    if( b != NULL && b != w->pr.dq_base && ( ( i - base_bidx ) & (n-1) ) > in_use ) {
+      w->pr.block_base[i] = NULL;
+      w->pu.pu_blocks->block[i] = NULL;
+      SFENCE;
+      discard_aligned( b, block_size( i ) * sizeof(Task) );
+      put_spare( w, i, b );
+      w->pr.n_resident -= block_size( i );
+    }
+  }
+
+#if WOOL_JOIN_STACK
+  if( w->pr.join_stack_top == NULL ) {
+    discard_aligned( w->pr.join_stack_base,
+                     (char *) w->pr.join_stack_hwm - (char *) w->pr.join_stack_base );
+    w->pr.join_stack_free = NULL;
+    w->pr.join_stack_bump = (_WOOL_(StolenTask) *) w->pr.join_stack_base;
+    w->pr.join_stack_hwm  = w->pr.join_stack_bump;
+  }
+#endif
+  if( spill_empty( w ) ) {
+    discard_aligned( spill_base( w ), spill_size );
+  }
+  w->pr.trim_pending = 0;
+  PR_INC( w, CTR_trims );
+}
+
 Task *_WOOL_(slow_spawn)( Worker *self, Task *p, _wool_task_header_t f )
 {
   /* This function is called for a spawn in either or both of the following cases
@@ -1514,37 +2484,59 @@ Task *_WOOL_(slow_spawn)( Worker *self, Task *p, _wool_task_header_t f )
   // The new task is allocated and ready to steal. Meanwhile, we might need to make additional
   // tasks public and maybe also set up a new block.
 
-  maybe_more_stealable( self, p_idx );
+  #if CHASE_LEV_SYNC
+    self->pu.cl_top = p_idx+1;
+  #endif
+
+  board_mark( self );
+
+  // A thief may be waiting for the oldest task, which may be the new one
+  ri_answer( self, p_idx+1 );
+
+  if( !maybe_more_stealable( self, p_idx ) && ( WOOL_RECV_INIT || p_idx < self->pr.n_public ) ) {
+    wake_one( self );
+  }
 
   if( next_free >= self->pr.block_base[idx] + block_size(idx) ) {
     // Make a new block
-    int new_idx = (idx+1) % _WOOL_pool_blocks;
-    unsigned long n_tasks = block_size(new_idx);
-    unsigned long s_idx = start_idx_of_block( self, new_idx );
+    int new_idx = (idx+1) % self->pr.n_blocks;
+    unsigned long n_tasks;
+    unsigned long s_idx;
     unsigned long n_public = self->pr.n_public;
-    int base_bidx = (self->pr.pool_base_idx / first_block_size) % _WOOL_pool_blocks;
+    int base_bidx = base_block( self );
+
+    if( new_idx == base_bidx && !can_evacuate( self, base_bidx, idx ) ) {
+      // Every block is in use and the oldest one can not be evacuated
+      grow_block_table( self );
+      idx = self->pr.t_idx;
+      new_idx = (idx+1) % self->pr.n_blocks;
+      base_bidx = base_block( self );
+    }
+    n_tasks = block_size(new_idx);
+    s_idx = start_idx_of_block( self, new_idx );
 
     self->pr.t_idx = new_idx;
     if( new_idx == base_bidx || self->pr.block_base[new_idx] == NULL ) {
       // fprintf( stderr, "%d %d\n", self->pr.idx, new_idx );
-      if( base_bidx != idx && is_stolen( self->pr.block_base[base_bidx] + first_block_size - 1 ) ) {
+      if( can_evacuate( self, base_bidx, idx ) ) {
         // The last task (and therefore all tasks) of the base block are stolen,
         // so we evacuate the base block to the join queue.
         self->pr.block_base[new_idx] = evacuate_oldest_block( self, s_idx );
         self->pr.block_base[base_bidx] = NULL;
-        self->pr.pool_base_idx += first_block_size;
-      } else if( new_idx != base_bidx ) {
-        // We can't evacuate the join block, but we have room for a new block
-        self->pr.block_base[new_idx] = (Task *) alloc_aligned( n_tasks * sizeof(Task), AA_HERE );
-        init_block( self->pr.block_base[new_idx], n_tasks,
-                    s_idx < n_public ? n_public - s_idx : 0 );
       } else {
-        // The task pool is really full, so we fail miserably.
-        fprintf( stderr, "Out of space for task stack\n" );
-        exit(1);
+        // We can't evacuate the join block, but we have room for a new block
+        Task *b = get_spare( self, new_idx );
+
+        if( b == NULL ) {
+          b = (Task *) alloc_aligned( n_tasks * sizeof(Task), AA_HERE );
+        }
+        self->pr.block_base[new_idx] = b;
+        init_block( b, n_tasks, s_idx < n_public ? n_public - s_idx : 0 );
+        self->pr.n_resident += n_tasks;
+        PR_MAX( self, CTR_pool_hwm_kb, self->pr.n_resident * sizeof(Task) / 1024 );
       }
       SFENCE;
-      self->pu.pu_block_base[new_idx] = self->pr.block_base[new_idx];
+      self->pu.pu_blocks->block[new_idx] = self->pr.block_base[new_idx];
     }
     next_free = self->pr.block_base[new_idx];
     // Support fast conversion of pointer to index
@@ -1566,7 +2558,7 @@ static Task *push_task( Worker *self, Task *p )
       self->pr.pr_top = p+1;
     } else {
       Task *tmp;
-      int new_idx = (idx+1) % _WOOL_pool_blocks;
+      int new_idx = (idx+1) % self->pr.n_blocks;
       assert( self->pr.block_base[new_idx] != NULL );
 
       self->pr.t_idx = new_idx;
@@ -1619,7 +2611,7 @@ static void pop_task( Worker *self, Task *p )
   if( p > base ) {
      p--;
   } else {
-    int idx = (self->pr.t_idx - 1) & (_WOOL_pool_blocks-1);  // Index of the *new* block we're poping into
+    int idx = (self->pr.t_idx - 1) & (self->pr.n_blocks-1);  // Index of the *new* block we're poping into
 
     assert( idx >= 0 );
 
@@ -1637,15 +2629,15 @@ static void pop_task( Worker *self, Task *p )
 }
 
 #if THE_SYNC
-balarm_t _WOOL_(sync_get_balarm)( Task *t )
+balarm_t _WOOL_(sync_get_balarm)( volatile Task *t )
 {
   Worker   *self;
   balarm_t  a;
 
-  self = get_self( t );
-  wool_lock( self->dq_lock );
+  self = _WOOL_(slow_get_self)();
+  wool_lock( self->pu.dq_lock );
     a = t->balarm;
-  wool_unlock( self->dq_lock );
+  wool_unlock( self->pu.dq_lock );
   PR_INC( self, CTR_sync_lock );
   return a;
 }
@@ -1698,7 +2690,7 @@ static int trans_leap( Worker *self, _wool_task_header_t card, volatile Task *or
     // When we get here, we have already attempted a steal from the worker owning this
     // pool.
 
-    if( thief_base >= thief->pu.dq_bot ) {
+    if( thief_base >= _WOOL_BOT_IDX( thief->pu.dq_bot ) ) {
       // We have looked at all eligible tasks in this worker's task pool, so pop
       // back into previous worker
 
@@ -1708,7 +2700,7 @@ static int trans_leap( Worker *self, _wool_task_header_t card, volatile Task *or
 
       // We're going to look at a task in the pool of the current thief
 
-      volatile Task      *t = idx_to_task_p_pu( thief, thief_base, thief->pu.pu_block_base[0] );
+      volatile Task      *t = idx_to_task_p_pu( thief, thief_base, thief->pu.pu_blocks->block[0] );
       _wool_task_header_t           r = t->hdr;
       unsigned long new_ssn = t->ssn;
 
@@ -1834,10 +2826,20 @@ void _WOOL_(rts_sync)( Worker *self, volatile Task *t, grab_res_t r )
   long w = 0;
 
 #if ! WOOL_SYNC_NOLOCK
-  wool_lock( self->dq_lock );
+  wool_lock( self->pu.dq_lock );
 #endif
 
     #if TWO_FIELD_SYNC
+     #if CHASE_LEV_SYNC
+      // Descriptors outside the current block are in the join stack, hence stolen
+      b = IN_CURRENT( self, t ) ? _WOOL_(grab_in_sync)( self, (Task *) t ) : TF_OCC;
+      f = t->hdr;
+      // A thief that has won the task may not have written its card yet
+      while( b == TF_OCC && SFS_IS_TASK( f ) ) {
+        WOOL_WAIT_CHECK(w);
+        f = READ_WRAPPER_ACQ( t->hdr );
+      }
+     #else
       b = r;
       f = t->hdr;
       while( SFS_IS_TASK( f ) && b == TF_OCC ) {
@@ -1850,11 +2852,14 @@ void _WOOL_(rts_sync)( Worker *self, volatile Task *t, grab_res_t r )
           b = _WOOL_(exch_busy_balarm)( &(t->balarm) );
         }
       }
+     #endif
       if( _WOOL_ordered_stores ) {
         if( SFS_IS_TASK( f ) ) {
           t->hdr = SFS_EMPTY;
         }
-        STORE_BALARM_T_REL( t->balarm, TF_FREE );
+        if( !WOOL_RECV_INIT ) {
+          STORE_BALARM_T_REL( t->balarm, TF_FREE );
+        }
       }
       if( SFS_IS_TASK( f ) ) {
         // It was never stolen or thief backed out
@@ -1904,7 +2909,7 @@ void _WOOL_(rts_sync)( Worker *self, volatile Task *t, grab_res_t r )
       assert( thief_idx <= n_workers );
 
 #if ! WOOL_SYNC_NOLOCK
-      wool_unlock( self->dq_lock );
+      wool_unlock( self->pu.dq_lock );
 #endif
       PR_INC( self, CTR_waits ); // It isn't waiting any more, though ...
 
@@ -1923,6 +2928,7 @@ void _WOOL_(rts_sync)( Worker *self, volatile Task *t, grab_res_t r )
         int steal_outcome = SO_NO_WORK;
 
         WOOL_WAIT_CHECK(ww);
+        ri_answer( self, 0 );
 
         if( !WOOL_FIXED_STEAL && switch_interval > 0 ) {
           steal_outcome = steal_one( self, thief, card, 0, t, t->ssn );
@@ -1970,7 +2976,7 @@ void _WOOL_(rts_sync)( Worker *self, volatile Task *t, grab_res_t r )
       time_event( self, 4 );
       logEvent( self, 4 );
 #if ! WOOL_SYNC_NOLOCK && ! WOOL_STEAL_NOLOCK
-      wool_lock( self->dq_lock );
+      wool_lock( self->pu.dq_lock );
 #endif
 
     } else {
@@ -1979,13 +2985,25 @@ void _WOOL_(rts_sync)( Worker *self, volatile Task *t, grab_res_t r )
     }
 
 #if WOOL_SYNC_NOLOCK && ! WOOL_STEAL_NOLOCK
-    wool_lock( self->dq_lock );
+    wool_lock( self->pu.dq_lock );
 #endif
 
     if( a != INLINED ) {
       assert( self->pr.curr_block_base <= self->pr.pr_top );
       t_idx = ptr2idx_curr( self, self->pr.pr_top );
-      #if ! WOOL_DEFER_BOT_DEC
+      #if CHASE_LEV_SYNC
+        // The pool is empty above bot, so no thief moves bot while we take it back,
+        // except on trial with WOOL_ASYM_FENCE, under our lock
+        if( WOOL_ASYM_FENCE ) {
+          wool_lock( self->pu.dq_lock );
+        }
+        self->pu.cl_top = t_idx;
+        COMPILER_FENCE;
+        self->pu.dq_bot = ( self->pu.dq_bot & ~( _WOOL_CL_TAG - 1 ) ) + _WOOL_CL_TAG + t_idx;
+        if( WOOL_ASYM_FENCE ) {
+          wool_unlock( self->pu.dq_lock );
+        }
+      #elif ! WOOL_DEFER_BOT_DEC
         if( !WOOL_FIXED_STEAL && ( ! WOOL_STEAL_OO || self->pu.dq_bot > t_idx )  ) {
           if( WOOL_ADD_STEALABLE && self->pr.highest_bot < t_idx+1 ) {
             self->pr.highest_bot = t_idx+1;
@@ -2016,12 +3034,31 @@ void _WOOL_(rts_sync)( Worker *self, volatile Task *t, grab_res_t r )
       #endif
     }
 
+#if WOOL_RECV_INIT
+    // The joined task was the last one handed over, and everything above it stays private
+    if( a != INLINED ) {
+      self->pu.dq_bot = t_idx;
+      self->pr.decrement_deferred = 0;
+      self->pr.n_public = t_idx;
+      self->pu.pu_n_public = t_idx;
+      reset_all_derived( self, 1 );
+    }
+#endif
+
 #if !WOOL_DEFER_NOT_STOLEN && !SINGLE_FIELD_SYNC
     t->balarm = NOT_STOLEN;
 #endif
 
 #if ! WOOL_STEAL_NOLOCK
-    wool_unlock( self->dq_lock );
+    wool_unlock( self->pu.dq_lock );
+#endif
+
+#if WOOL_REDUCERS
+    _WOOL_(StolenTask) *st = (_WOOL_(StolenTask) *) t;
+
+    if( a != INLINED && st->info.views != NULL ) {
+      _WOOL_(merge_views)( self, st->info.views );
+    }
 #endif
 
 }
@@ -2049,6 +3086,9 @@ Task *_WOOL_(slow_sync)( Worker *self, Task *p, grab_res_t grab_res )
   maybe_less_stealable( self, p );
 #endif
 
+  // Only tasks below the one we join with may be handed over
+  ri_answer( self, p_idx > 0 ? p_idx-1 : 0 );
+
   assert( self->pr.curr_block_base != NULL );
 
   if( __builtin_expect( self->pr.curr_block_base < p, 1 ) ) {
@@ -2074,7 +3114,7 @@ Task *_WOOL_(slow_sync)( Worker *self, Task *p, grab_res_t grab_res )
 #endif
   } else {
     // Now we pop back into a lower block
-    self->pr.t_idx = (self->pr.t_idx-1) & (_WOOL_pool_blocks-1);
+    self->pr.t_idx = (self->pr.t_idx-1) & (self->pr.n_blocks-1);
     // Support fast conversion of pointer to index
     self->pr.curr_block_fidx = start_idx_of_block( self, self->pr.t_idx );
     self->pr.curr_block_base = self->pr.block_base[self->pr.t_idx];
@@ -2129,7 +3169,12 @@ struct _WorkerData {
 };
 
 static int worker_offset = LINE_SIZE;
-static int join_stack_size = 1024*1024;
+
+void _WOOL_(spill_overflow)( void )
+{
+  fprintf( stderr, "Out of space for spilled task arguments\n" );
+  exit( 1 );
+}
 
 static void init_worker( int w_idx )
 {
@@ -2138,9 +3183,6 @@ static void init_worker( int w_idx )
   struct _WorkerData *d;
   int offset = w_idx * worker_offset;
   int size = first_block_size * sizeof(Task);
-#if WOOL_JOIN_STACK
-  Task *stolen_js = NULL;
-#endif
 
   // We're offsetting the worker data a bit to avoid cache conflicts
   d = (struct _WorkerData *)
@@ -2149,15 +3191,24 @@ static void init_worker( int w_idx )
 
   w->pr.dq_base = &(d->p[0]);
   bases[w_idx] = w->pr.dq_base;
+  w->pr.spill_top = alloc_aligned( spill_size, AA_LAZY );
+  if( w->pr.spill_top == NULL ) {
+    fprintf( stderr, "Out of memory for the spill arena\n" );
+    exit( 1 );
+  }
+  w->pr.spill_end = w->pr.spill_top + spill_size;
+  w->pr.spill_top += _WOOL_SPILL_ALIGN;
 #if WOOL_JOIN_STACK
-  w->pr.join_stack_base = alloc_aligned( join_stack_size * sizeof(Task), AA_HERE );
-  stolen_js = w->pr.join_stack_base;
-  w->pr.join_stack_top = NULL;
-  for( i = 1; i < join_stack_size; i++ ) {
-    ((_WOOL_(StolenTask) *) (stolen_js+i-1))->info.next = (_WOOL_(StolenTask) *) (stolen_js+i);
-  }
-  ((_WOOL_(StolenTask) *) (stolen_js+join_stack_size-1))->info.next = NULL;
-  w->pr.join_stack_free = (_WOOL_(StolenTask) *) stolen_js;
+  w->pr.join_stack_base = alloc_aligned( join_stack_size * sizeof(Task), AA_LAZY );
+  if( w->pr.join_stack_base == NULL ) {
+    fprintf( stderr, "Out of memory for the join stack\n" );
+    exit( 1 );
+  }
+  w->pr.join_stack_top  = NULL;
+  w->pr.join_stack_free = NULL;
+  w->pr.join_stack_bump = (_WOOL_(StolenTask) *) w->pr.join_stack_base;
+  w->pr.join_stack_end  = (_WOOL_(StolenTask) *) ( w->pr.join_stack_base + join_stack_size );
+  w->pr.join_stack_hwm  = w->pr.join_stack_bump;
   w->pr.join_stack_top_idx = 0;
   w->pr.pool_base_idx = 0;
   w->pu.pool_base_idx = 0; // Should be kept in step with the private version
@@ -2168,10 +3219,23 @@ static void init_worker( int w_idx )
   w->pr.more_work = 2;
   assert( n_stealable >= 0 );
   init_block( w->pr.dq_base, first_block_size, (unsigned long) n_stealable );
+  w->pr.n_blocks = _WOOL_pool_blocks;
+  w->pr.block_base = malloc( _WOOL_pool_blocks * sizeof(Task *) );
+  w->pr.spare_blocks = malloc( _WOOL_pool_blocks * sizeof(Task *) );
+  w->pr.n_spare = 0;
+  w->pr.n_resident = first_block_size;
+  w->pr.trim_pending = 0;
+  w->pu.pu_blocks = malloc( sizeof(_WOOL_(BlockTable)) + _WOOL_pool_blocks * sizeof(Task *) );
+  w->pu.pu_blocks->n_blocks = _WOOL_pool_blocks;
+  w->pu.pu_blocks->older = NULL;
   w->pr.block_base[0] = w->pr.dq_base;
-  w->pu.pu_block_base[0] = w->pr.dq_base;
+  w->pu.pu_blocks->block[0] = w->pr.dq_base;
   for( i = 1; i < _WOOL_pool_blocks; i++ ) {
     w->pr.block_base[i] = NULL;
+    w->pu.pu_blocks->block[i] = NULL;
+  }
+  for( i = 0; i < _WOOL_pool_blocks; i++ ) {
+    w->pr.spare_blocks[i] = NULL;
   }
   w->pr.t_idx = 0;
 
@@ -2183,6 +3247,9 @@ static void init_worker( int w_idx )
   w->pr.n_public = n_stealable;
   w->pu.pu_n_public = n_stealable;
   w->pr.storage = NULL;
+  #if WOOL_COST_HINTS
+    w->pr.next_cost = 0;
+  #endif
   w->pr.highest_bot = 0;
   w->pu.dq_lock = &( w->pu.the_lock );
   pthread_mutex_init( w->pu.dq_lock, NULL );
@@ -2190,6 +3257,17 @@ static void init_worker( int w_idx )
   pthread_cond_init( &( w->pu.work_available ), NULL );
   w->pu.fun = NULL;
   w->pu.fun_arg = NULL;
+  w->pu.parked = 0;
+  #if WOOL_AFFINITY
+    w->pu.mailbox = 0;
+  #endif
+  #if CHASE_LEV_SYNC
+    w->pu.cl_top = 0;
+  #endif
+  #if WOOL_RECV_INIT
+    w->pu.ri_request = 0;
+    w->pu.ri_reply = NULL;
+  #endif
   for( i=0; i < CTR_MAX; i++ ) {
     w->pr.ctr[i] = 0;
   }
@@ -2226,12 +3304,273 @@ static void init_worker( int w_idx )
 
 #ifdef __APPLE__
 #define set_worker_affinity(x) /* Nothing */
+#define DIST_CLASSES 4
+#define worker_distance(a,b) 0
 #else
 
 static int affinity_mode = 0;
 
-static int chip_major[] = {0, 2, 4, 6, 1, 3, 5, 7};
-static int chip_minor[] = {0, 1, 2, 3, 4, 5, 6, 7};
+// CPU topology, as read from /sys/devices/system/cpu for the CPUs we may
+// run on. Each placement policy is an ordering of this table; thread i
+// goes on the i'th CPU in the order.
+
+#define TOPO_PATH "/sys/devices/system/cpu/cpu%d/"
+
+typedef struct {
+  int cpu;
+  int package;
+  int core;     // Physical core id, unique within the package
+  int smt;      // Index among the hardware threads of the core
+  int l3;       // Id of the last level cache domain
+  int node;     // NUMA node
+  int rank;     // Position of the core within its node, for scattering
+} cpu_info_t;
+
+static cpu_info_t topology[MAX_THREADS];
+static int        n_topology = 0;
+static int        worker_cpu[MAX_THREADS]; // Where each thread was placed, or -1
+
+typedef enum {
+  PLACE_COMPACT = 1,     // Fill a node, a cache and a core before the next
+  PLACE_SCATTER = 2,     // Round robin over the nodes
+  PLACE_CORES_FIRST = 5  // One thread per physical core, then the SMT siblings
+} placement_t;
+
+static int read_sys_int( const char *fmt, int cpu, int sub, int dflt )
+{
+  char path[256];
+  FILE *f;
+  int v;
+
+  snprintf( path, sizeof(path), fmt, cpu, sub );
+  f = fopen( path, "r" );
+  if( f == NULL ) {
+    return dflt;
+  }
+  if( fscanf( f, "%d", &v ) != 1 ) {
+    v = dflt;
+  }
+  fclose( f );
+  return v;
+}
+
+// Returns the position of cpu in a list like "0-3,8-11", or -1 if absent.
+static int cpu_list_pos( const char *list, int cpu )
+{
+  int pos = 0;
+
+  while( *list != '\0' ) {
+    char *end;
+    int lo = strtol( list, &end, 10 ), hi = lo;
+
+    if( end == list ) break;
+    if( *end == '-' ) {
+      list = end+1;
+      hi = strtol( list, &end, 10 );
+    }
+    if( lo <= cpu && cpu <= hi ) {
+      return pos + cpu - lo;
+    }
+    pos += hi - lo + 1;
+    list = *end == ',' ? end+1 : end;
+    if( *end != ',' ) break;
+  }
+  return -1;
+}
+
+static int read_cpu_list_pos( const char *fmt, int cpu, int sub, int which )
+{
+  char path[256], buf[1024];
+  FILE *f;
+  int r = -1;
+
+  snprintf( path, sizeof(path), fmt, cpu, sub );
+  f = fopen( path, "r" );
+  if( f != NULL ) {
+    if( fgets( buf, sizeof(buf), f ) != NULL ) {
+      r = cpu_list_pos( buf, which );
+    }
+    fclose( f );
+  }
+  return r;
+}
+
+static int cpu_l3( int cpu )
+{
+  int i, level;
+
+  for( i = 0; ( level = read_sys_int( TOPO_PATH "cache/index%d/level", cpu, i, -1 ) ) != -1; i++ ) {
+    if( level == 3 ) {
+      int id = read_sys_int( TOPO_PATH "cache/index%d/id", cpu, i, -1 );
+      char path[256];
+      FILE *f;
+      if( id != -1 ) {
+        return id;
+      }
+      // Older kernels have no id; use the lowest CPU sharing the cache
+      snprintf( path, sizeof(path), TOPO_PATH "cache/index%d/shared_cpu_list", cpu, i );
+      f = fopen( path, "r" );
+      if( f != NULL ) {
+        if( fscanf( f, "%d", &id ) != 1 ) id = -1;
+        fclose( f );
+      }
+      return id;
+    }
+  }
+  return -1;
+}
+
+static int cpu_node( int cpu )
+{
+  char path[256];
+  DIR *d;
+  struct dirent *e;
+  int n = 0;
+
+  // There is a nodeN link in the CPU directory when NUMA is configured
+  snprintf( path, sizeof(path), TOPO_PATH, cpu );
+  d = opendir( path );
+  if( d == NULL ) {
+    return 0;
+  }
+  while( ( e = readdir( d ) ) != NULL ) {
+    if( sscanf( e->d_name, "node%d", &n ) == 1 ) {
+      break;
+    }
+  }
+  closedir( d );
+  return n;
+}
+
+static void discover_topology( cpu_set_t *mask )
+{
+  int cpu, i, j;
+
+  n_topology = 0;
+  for( cpu = 0; cpu < CPU_SETSIZE && n_topology < MAX_THREADS; cpu++ ) {
+    cpu_info_t *t = topology + n_topology;
+    int smt;
+
+    if( !CPU_ISSET( cpu, mask ) ) continue;
+    t->cpu     = cpu;
+    t->package = read_sys_int( TOPO_PATH "topology/physical_package_id", cpu, 0, 0 );
+    t->core    = read_sys_int( TOPO_PATH "topology/core_id", cpu, 0, cpu );
+    smt        = read_cpu_list_pos( TOPO_PATH "topology/thread_siblings_list", cpu, 0, cpu );
+    t->smt     = smt < 0 ? 0 : smt;
+    t->l3      = cpu_l3( cpu );
+    if( t->l3 == -1 ) t->l3 = t->package;
+    t->node    = cpu_node( cpu );
+    n_topology++;
+  }
+  #if defined(__linux__) && !defined(__TILECC__)
+    n_nodes = 1;
+    for( i = 0; i < n_topology; i++ ) {
+      if( topology[i].node >= n_nodes ) n_nodes = topology[i].node + 1;
+    }
+  #endif
+
+  // Rank the cores of each node in order of cache and core
+  for( i = 0; i < n_topology; i++ ) {
+    cpu_info_t *t = topology + i;
+    t->rank = 0;
+    for( j = 0; j < n_topology; j++ ) {
+      cpu_info_t *o = topology + j;
+      if( o->node == t->node && o->smt == 0 &&
+          ( o->l3 < t->l3 || ( o->l3 == t->l3 &&
+            ( o->package < t->package || ( o->package == t->package && o->core < t->core ) ) ) ) ) {
+        t->rank++;
+      }
+    }
+  }
+}
+
+static placement_t sort_placement;
+
+#define TOPO_CMP(a,b) if( (a) != (b) ) return (a) < (b) ? -1 : 1
+
+static int cmp_placement( const void *x, const void *y )
+{
+  const cpu_info_t *a = x, *b = y;
+
+  switch( sort_placement ) {
+    case PLACE_COMPACT:
+      TOPO_CMP( a->node, b->node );
+      TOPO_CMP( a->l3, b->l3 );
+      TOPO_CMP( a->package, b->package );
+      TOPO_CMP( a->core, b->core );
+      TOPO_CMP( a->smt, b->smt );
+      break;
+    case PLACE_SCATTER:
+      TOPO_CMP( a->smt, b->smt );
+      TOPO_CMP( a->rank, b->rank );
+      TOPO_CMP( a->node, b->node );
+      break;
+    case PLACE_CORES_FIRST:
+      TOPO_CMP( a->smt, b->smt );
+      TOPO_CMP( a->node, b->node );
+      TOPO_CMP( a->l3, b->l3 );
+      TOPO_CMP( a->package, b->package );
+      TOPO_CMP( a->core, b->core );
+      break;
+  }
+  TOPO_CMP( a->cpu, b->cpu );
+  return 0;
+}
+
+static int placement_order[MAX_THREADS];
+
+static void make_placement( placement_t p )
+{
+  cpu_info_t sorted[MAX_THREADS];
+  int i;
+
+  memcpy( sorted, topology, n_topology * sizeof(cpu_info_t) );
+  sort_placement = p;
+  qsort( sorted, n_topology, sizeof(cpu_info_t), cmp_placement );
+  for( i = 0; i < n_topology; i++ ) {
+    placement_order[i] = sorted[i].cpu;
+  }
+}
+
+static const cpu_info_t *cpu_topology( int cpu )
+{
+  int i;
+
+  for( i = 0; i < n_topology; i++ ) {
+    if( topology[i].cpu == cpu ) {
+      return topology + i;
+    }
+  }
+  return NULL;
+}
+
+#if defined(__linux__) && !defined(__TILECC__)
+// The NUMA node we are running on, for placing memory
+static int local_node( void )
+{
+  int cpu = sched_getcpu();
+  const cpu_info_t *t = cpu >= 0 ? cpu_topology( cpu ) : NULL;
+
+  return t == NULL ? -1 : t->node;
+}
+#endif
+
+// Distance classes between the CPUs of two workers: 0 for SMT siblings
+// (or unknown placement), 1 for the same last level cache, 2 for the
+// same NUMA node and 3 for different nodes.
+#define DIST_CLASSES 4
+
+static int worker_distance( int a, int b )
+{
+  const cpu_info_t *x = cpu_topology( worker_cpu[ a / workers_per_thread ] ),
+                   *y = cpu_topology( worker_cpu[ b / workers_per_thread ] );
+
+  if( x == NULL || y == NULL ) return 0;
+  if( x->node != y->node ) return 3;
+  if( x->l3 != y->l3 ) return 2;
+  if( x->package != y->package || x->core != y->core ) return 1;
+  return 0;
+}
 
 static void set_worker_affinity( int w_idx )
 {
@@ -2240,11 +3579,12 @@ static void set_worker_affinity( int w_idx )
 
   switch( affinity_mode ) {
     case 0 : break;
-    case 1 : /* Pack chip first */
-             desired_core = chip_major[ thread_idx ];
-             break;
-    case 2 : /* Spread out among chips */
-             desired_core = chip_minor[ thread_idx ];
+    case PLACE_COMPACT :
+    case PLACE_SCATTER :
+    case PLACE_CORES_FIRST :
+             if( n_topology > 0 ) {
+               desired_core = placement_order[ thread_idx % n_topology ];
+             }
              break;
     case 3 : /* Individual choices */
              desired_core = affinity_table[ thread_idx ] - 1;
@@ -2253,6 +3593,7 @@ static void set_worker_affinity( int w_idx )
              desired_core = thread_idx;
              break;
   }
+  worker_cpu[ thread_idx ] = desired_core;
   if( desired_core != -1 ) {
     const int size = sizeof(cpu_set_t);
     cpu_set_t set;
@@ -2316,13 +3657,107 @@ static const int parsamp_size = WOOL_STEAL_PARSAMP ? 1 : 0;
   #define FAST_TIME(t) /* Empty */
 #endif
 
+#if TWO_FIELD_SYNC
+
+// The checks of the two field steal protocol, used by steal() and
+// steal_more() alike. Before the exchange on balarm, a thief gives up on a
+// task that is occupied or, with ordered stores, not a task any more.
+// After it, the task must still be one and still be the bottom task.
+
+static inline int tf_may_steal( volatile Task *tp )
+{
+  return tp->balarm != TF_OCC && ( !_WOOL_ordered_stores || SFS_IS_TASK( tp->hdr ) );
+}
+
+static inline int tf_got_task( Worker *victim, unsigned long idx, _wool_task_header_t f )
+{
+  return ( !_WOOL_ordered_stores || SFS_IS_TASK( f ) ) && victim->pu.dq_bot == idx;
+}
+
+#endif
+
+#if WOOL_STEAL_BATCH
+
+// Batch stealing. Having stolen the task at bot_idx, a thief from
+// look_for_work takes up to half of the other public tasks of the victim in
+// the same visit, but at most steal_batch tasks in all. Each one is stolen
+// with the usual protocol and run by a proxy task in the thief's own pool,
+// where further thieves can find it, so a wide fan out spreads in a
+// logarithmic number of rounds.
+
+static int steal_batch = 16; // Set by '-B', 1 turns batching off
+
+VOID_TASK_2( batch_proxy, Task *, tp, _wool_task_header_t, f )
+{
+  Task *ntp = run_stolen( __self, tp, f );
+
+  COMPILER_FENCE;
+  STORE_WRAPPER_REL( ntp->hdr, SFS_DONE );
+}
+
+static int steal_more( Worker *self, Worker *victim, unsigned long bot_idx, _wool_task_header_t card )
+{
+  unsigned long pub  = victim->pu.pu_n_public;
+  unsigned long want = bot_idx < pub ? ( pub - bot_idx + 1 ) / 2 : 1;
+  unsigned long i;
+
+  if( want > (unsigned long) steal_batch ) {
+    want = steal_batch;
+  }
+  for( i = 1; i < want; i++ ) {
+    unsigned long idx = bot_idx + i;
+    volatile Task *tp = idx_to_task_p_pu( victim, idx, victim->pu.pu_blocks->block[0] );
+    _wool_task_header_t f;
+    balarm_t alarm;
+    #if WOOL_TRLF
+      unsigned long booty_ssn;
+    #endif
+
+    if( tp == NULL || !tf_may_steal( tp ) ) {
+      break;
+    }
+    #if WOOL_TRLF
+      booty_ssn = tp->ssn;
+    #endif
+    alarm = _WOOL_(exch_busy_balarm)( &(tp->balarm) );
+    if( alarm == TF_OCC ) {
+      break;
+    }
+    #if WOOL_BALARM_CACHING
+      f = alarm == TF_FREE ? tp->hdr : alarm;
+    #else
+      f = tp->hdr;
+    #endif
+    if( !tf_got_task( victim, idx, f ) ) {
+      tp->balarm = WOOL_BALARM_CACHING ? alarm : TF_FREE;
+      break;
+    }
+    victim->pu.dq_bot = idx+1;
+    #if WOOL_JOIN_STACK
+      tp->join_data.back_link = NULL;
+    #endif
+    STORE_PTR_REL(tp->hdr, card);
+    #if WOOL_TRLF
+      tp->ssn = booty_ssn+1;
+    #endif
+    batch_proxy_SPAWN( self, (Task *) tp, f );
+  }
+  PR_ADD( self, CTR_steal_batched, i-1 );
+  return i-1;
+}
+
+#endif
+
+#if !WOOL_RECV_INIT && !CHASE_LEV_SYNC
+
 static int
 steal( Worker *self, Worker **victim_p, _wool_task_header_t card, int flags, volatile Task *jt, unsigned long ssn )
 {
   volatile Task   *tp;
   _wool_task_header_t        f = T_BUSY;
-#if TWO_FIELD_SYNC
+#if TWO_FIELD_SYNC && !THE_SYNC
   balarm_t         alarm;
+  long unsigned    tmp_ssn;
 #endif
   Worker          *victim;
   int              is_old_thief = flags & ST_OLD;
@@ -2330,7 +3765,6 @@ steal( Worker *self, Worker **victim_p, _wool_task_header_t card, int flags, vol
 #if WOOL_TRLF
   long unsigned    booty_ssn = 0;
 #endif
-  long unsigned    tmp_ssn;
   int              is_thief;
 
 #if WOOL_FAST_TIME
@@ -2381,11 +3815,11 @@ steal( Worker *self, Worker **victim_p, _wool_task_header_t card, int flags, vol
   bot_idx0  = victim0->pu.dq_bot;
   flag0     = victim0->pu.flag;               // The depth of the task at the base of the stack
   is_thief0 = victim0->pu.is_thief;
-  base0     = victim0->pu.pu_block_base[0];
+  base0     = victim0->pu.pu_blocks->block[0];
   bot_idx1  = victim1->pu.dq_bot;
   flag1     = victim1->pu.flag;               // The depth of the task at the base of the stack
   is_thief1 = victim1->pu.is_thief;
-  base1     = victim1->pu.pu_block_base[0];
+  base1     = victim1->pu.pu_blocks->block[0];
 
   tp0 = idx_to_task_p_pu( victim0, bot_idx0, base0 );
   tp1 = idx_to_task_p_pu( victim1, bot_idx1, base1 );
@@ -2451,7 +3885,7 @@ steal( Worker *self, Worker **victim_p, _wool_task_header_t card, int flags, vol
   tp = victim->pr.dq_base + idx; // idx must be less than size of first block!
 #else
   bot_idx = victim->pu.dq_bot;
-  base    = victim->pu.pu_block_base[0];
+  base    = victim->pu.pu_blocks->block[0];
   if( bot_idx < first_block_size ) {
     tp = base + bot_idx;
   } else {
@@ -2478,7 +3912,7 @@ steal( Worker *self, Worker **victim_p, _wool_task_header_t card, int flags, vol
   #if WOOL_TRLF
     booty_ssn = tp->ssn;
   #endif
-  if( tp->balarm == TF_OCC || ( _WOOL_ordered_stores && ! SFS_IS_TASK(tp->hdr) ) ) {
+  if( !tf_may_steal( tp ) ) {
     time_event( self, 7 );
     return SO_NO_WORK;
   }
@@ -2505,21 +3939,21 @@ steal( Worker *self, Worker **victim_p, _wool_task_header_t card, int flags, vol
   PREFETCH( tp->hdr ); // Start getting exclusive access
 
 #if STEAL_TRYLOCK
-  if( wool_trylock( victim->dq_lock ) != 0 ) {
+  if( wool_trylock( victim->pu.dq_lock ) != 0 ) {
     time_event( self, 7 );
     return SO_BUSY;
   }
 #else
-  wool_lock( victim->dq_lock );
+  wool_lock( victim->pu.dq_lock );
 #endif
   // now locked!
   // but only if we use locks!
 
     // Yes, we need to reread after aquiring lock!
     bot_idx = victim->pu.dq_bot;
-    tp = idx_to_task_p_pu( victim, bot_idx, base );
+    tp = idx_to_task_p_pu( victim, bot_idx, (Task *) base );
     if( tp == NULL ) {
-      wool_unlock( victim->dq_lock );
+      wool_unlock( victim->pu.dq_lock );
       return SO_NO_WORK;
     }
 
@@ -2539,7 +3973,7 @@ steal( Worker *self, Worker **victim_p, _wool_task_header_t card, int flags, vol
                         && tp->hdr > (_wool_task_header_t) T_LAST  ) ) {
 #if THE_SYNC
       // THE version, uses locks between thieves (ie !WOOL_STEAL_NOLOCK)
-      tp->balarm = self_idx;
+      tp->balarm = self->pr.idx;
       MFENCE;
       f = tp->hdr;
 
@@ -2567,8 +4001,7 @@ steal( Worker *self, Worker **victim_p, _wool_task_header_t card, int flags, vol
         #if WOOL_STEAL_REPF
           __builtin_prefetch( tp );
         #endif
-        if( ( !_WOOL_ordered_stores || SFS_IS_TASK( f ))
-             && __builtin_expect( victim->pu.dq_bot == bot_idx, 1 )
+        if( __builtin_expect( tf_got_task( victim, bot_idx, f ), 1 )
              && (__builtin_expect( jt == NULL, 1 )
                  || ( tmp_ssn = jt->ssn, __builtin_expect( jt->hdr != SFS_DONE, 1 )
                    && __builtin_expect( tmp_ssn == ssn, 1 ) ) ) ) {
@@ -2638,17 +4071,25 @@ steal( Worker *self, Worker **victim_p, _wool_task_header_t card, int flags, vol
       tp = NULL; // Already stolen by someone else
     }
 #if !WOOL_STEAL_NOLOCK
-  wool_unlock( victim->dq_lock );
+  wool_unlock( victim->pu.dq_lock );
 #endif
 
   if( tp != NULL ) {
     Task* ntp;
+    #if WOOL_STEAL_BATCH
+      int n_batch = 0;
+    #endif
 
     // fprintf( stderr, "S %d %d %lu\n", self_idx, victim_idx, tp - victim->pr.block_base[0] );
 
     FAST_TIME(t_pre_rs);
     maybe_request_stealable( victim, bot_idx, victim->pu.pu_n_public );
 
+    // The victim probably has more, so pass the wakeup on
+    if( bot_idx + 1 < victim->pu.pu_n_public ) {
+      wake_one( self );
+    }
+
     // One less old thief?
     if( is_old_thief ) {
       decrement_old_thieves( );
@@ -2667,6 +4108,12 @@ steal( Worker *self, Worker **victim_p, _wool_task_header_t card, int flags, vol
       }
     #endif
 
+    #if WOOL_STEAL_BATCH
+      if( jt == NULL && ( flags & (ST_THIEF|ST_MAIL) ) == ST_THIEF && steal_batch > 1 ) {
+        n_batch = steal_more( self, victim, bot_idx, card );
+      }
+    #endif
+
     #if WOOL_SLOW_STEAL
       v = spin( self, global_steal_delay );
     #endif
@@ -2694,7 +4141,21 @@ steal( Worker *self, Worker **victim_p, _wool_task_header_t card, int flags, vol
     #endif
 
     // The task may have been scavenged during its evaluation, so it may now reside in the join stack.
-    ntp = f->f( self, (Task *) tp );
+    #if WOOL_STEAL_BOARD
+      // Have the first spawn of the stolen task show on the board
+      if( board_in_use ) {
+        throw_spawn_exception( self );
+      }
+    #endif
+
+    ntp = run_stolen( self, (Task *) tp, f );
+
+    #if WOOL_STEAL_BOARD
+      // The pool is empty again
+      if( board_in_use && steal_board[ self->pr.idx ] ) {
+        steal_board[ self->pr.idx ] = 0;
+      }
+    #endif
 
     logEvent( self, 2 );
     time_event( self, 2 );
@@ -2713,6 +4174,13 @@ steal( Worker *self, Worker **victim_p, _wool_task_header_t card, int flags, vol
         STORE_BALARM_T_REL( ntp->balarm, /* (volatile balarm_t) */ STOLEN_DONE );
       #endif
 
+    #if WOOL_STEAL_BATCH
+      // The rest of the batch, unless other thieves took it
+      while( n_batch-- > 0 ) {
+        batch_proxy_SYNC( self );
+      }
+    #endif
+
     time_event( self, 8 );
     return SO_STOLE;
   }
@@ -2720,117 +4188,758 @@ steal( Worker *self, Worker **victim_p, _wool_task_header_t card, int flags, vol
   return SO_BUSY;
 }
 
-static int steal_one( Worker *self, Worker * victim, _wool_task_header_t card, int flags, volatile Task *jt, unsigned long ssn )
+#else
+
+// Runs a task just taken from victim, as steal() does after a successful steal
+
+static int run_booty( Worker *self, Worker *victim, Task *tp, _wool_task_header_t f, int flags )
+{
+  Task *ntp;
+
+  if( flags & ST_OLD ) {
+    decrement_old_thieves( );
+  }
+  #if ( WOOL_STEAL_SET || WOOL_STEAL_DKS )
+    if( flags & ST_THIEF ) {
+      self->pu.is_thief = 0;
+    }
+  #endif
+  #if WOOL_STEAL_SAMPLE
+    if( flags & ST_THIEF ) {
+      self->pu.flag = victim->pu.flag + _WOOL_BOT_IDX( victim->pu.dq_bot );
+    }
+  #endif
+
+  time_event( self, 1 );
+  logEvent( self, 1 );
+
+  #if WOOL_STEAL_BOARD
+    if( board_in_use ) {
+      throw_spawn_exception( self );
+    }
+  #endif
+
+  ntp = run_stolen( self, tp, f );
+
+  #if WOOL_STEAL_BOARD
+    if( board_in_use && steal_board[ self->pr.idx ] ) {
+      steal_board[ self->pr.idx ] = 0;
+    }
+  #endif
+
+  logEvent( self, 2 );
+  time_event( self, 2 );
+
+  COMPILER_FENCE;
+  STORE_WRAPPER_REL( ntp->hdr, SFS_DONE );
+
+  time_event( self, 8 );
+  return SO_STOLE;
+}
+
+#endif
+
+#if WOOL_RECV_INIT
+
+static int ri_patience = 2000; // Rounds waiting for an answer before withdrawing a request
+
+// The thief side of receiver initiated stealing, see ri_answer()
+
+static int ri_steal( Worker *self, Worker *victim, _wool_task_header_t card, int flags, volatile Task *jt )
+{
+  int self_idx1 = self->pr.idx + 1;
+  int waits = 0;
+  Task *tp;
+
+  if( victim->pu.ri_request != 0 ) {
+    time_event( self, 7 );
+    return SO_BUSY;
+  }
+  self->pu.ri_card = card;
+  self->pu.ri_join = (Task *) jt;
+  self->pu.ri_reply = NULL;
+  if( !__sync_bool_compare_and_swap( &( victim->pu.ri_request ), 0, self_idx1 ) ) {
+    time_event( self, 7 );
+    return SO_BUSY;
+  }
+  #if WOOL_ASYM_FENCE
+    thief_fence(); // See maybe_request_stealable()
+  #endif
+  throw_both_exceptions( victim );
+
+  while( ( tp = READ_PTR_ACQ( self->pu.ri_reply, Task * ) ) == NULL ) {
+    // Somebody may be waiting for us in turn
+    ri_answer( self, 0 );
+    if( waits >= 0 && ++waits > ri_patience ) {
+      if( __sync_bool_compare_and_swap( &( victim->pu.ri_request ), self_idx1, 0 ) ) {
+        time_event( self, 7 );
+        return SO_BUSY;
+      }
+      // The victim has taken the request, so the answer is on its way
+      waits = -1;
+    }
+  }
+  if( tp == &ri_no_task ) {
+    time_event( self, 7 );
+    return SO_NO_WORK;
+  }
+
+  return run_booty( self, victim, tp, self->pu.ri_f, flags );
+}
+
+#endif
+
+#if CHASE_LEV_SYNC
+
+// The thief side of CHASE_LEV_SYNC. The task is read before the compare
+// and swap of bot and is ours if that succeeds; the owner only reuses the
+// descriptor after taking the bottom back, which changes the tag of bot.
+//
+// With WOOL_ASYM_FENCE, the owner does not fence between lowering cl_top
+// and reading bot, so a thief cannot trust what it reads of cl_top until
+// it has raised bot and called thief_fence(). Thieves hold the lock of the
+// victim while bot is raised on trial, and the owner takes it whenever it
+// finds bot too close to look at without it.
+
+static int cl_steal( Worker *self, Worker *victim, _wool_task_header_t card, int flags, volatile Task *jt, unsigned long ssn )
+{
+  unsigned long b, bot_idx;
+  _wool_task_header_t f;
+  Task *tp;
+
+#if WOOL_ASYM_FENCE
+  if( wool_trylock( victim->pu.dq_lock ) != 0 ) {
+    time_event( self, 7 );
+    return SO_BUSY;
+  }
+#endif
+  b = victim->pu.dq_bot;
+  bot_idx = _WOOL_BOT_IDX( b );
+  COMPILER_FENCE; // Loads are ordered, so top is read after bot
+  if( bot_idx >= victim->pu.cl_top ) {
+    tp = NULL;
+  } else {
+    tp = idx_to_task_p_pu( victim, bot_idx, victim->pu.pu_blocks->block[0] );
+  }
+  // When leapfrogging, the thief we help must still be working on our task
+  if( jt != NULL && tp != NULL && ( jt->hdr == SFS_DONE || jt->ssn != ssn ) ) {
+    tp = NULL;
+  }
+#if WOOL_ASYM_FENCE
+  if( tp != NULL ) {
+    victim->pu.dq_bot = b+1;
+    thief_fence();
+    if( bot_idx >= victim->pu.cl_top || !SFS_IS_TASK( f = tp->hdr ) ) {
+      victim->pu.dq_bot = b; // The owner got there first
+      tp = NULL;
+    }
+  }
+  wool_unlock( victim->pu.dq_lock );
+  if( tp == NULL ) {
+    time_event( self, 7 );
+    return SO_NO_WORK;
+  }
+#else
+  if( tp == NULL || !SFS_IS_TASK( f = tp->hdr ) ) {
+    time_event( self, 7 );
+    return SO_NO_WORK;
+  }
+  if( !__sync_bool_compare_and_swap( &( victim->pu.dq_bot ), b, b+1 ) ) {
+    time_event( self, 7 );
+    return SO_BUSY;
+  }
+#endif
+  #if WOOL_JOIN_STACK
+    tp->join_data.back_link = NULL;
+  #endif
+  #if WOOL_TRLF
+    tp->ssn++;
+  #endif
+  STORE_PTR_REL( tp->hdr, card );
+
+  // The victim probably has more, so pass the wakeup on
+  if( bot_idx + 1 < victim->pu.cl_top ) {
+    wake_one( self );
+  }
+  return run_booty( self, victim, tp, f, flags );
+}
+
+// Called from grab_in_sync() when top has come down to bot. The owner gets
+// the last task by bumping the tag of bot, which makes the compare and swap
+// of any thief fail; if bot has already moved past the task, it is stolen.
+
+grab_res_t _WOOL_(cl_pop_last)( Worker *self, unsigned long t_idx )
+{
+#if WOOL_ASYM_FENCE
+  // No thief has bot raised on trial while we hold the lock
+  grab_res_t res = TF_OCC;
+  unsigned long b;
+
+  wool_lock( self->pu.dq_lock );
+  b = self->pu.dq_bot;
+  if( _WOOL_BOT_IDX( b ) == t_idx ) {
+    self->pu.dq_bot = b + _WOOL_CL_TAG;
+    res = TF_FREE;
+  }
+  wool_unlock( self->pu.dq_lock );
+  return res;
+#else
+  unsigned long b = self->pu.dq_bot;
+
+  if( _WOOL_BOT_IDX( b ) == t_idx &&
+      __sync_bool_compare_and_swap( &( self->pu.dq_bot ), b, b + _WOOL_CL_TAG ) ) {
+    return TF_FREE;
+  }
+  return TF_OCC;
+#endif
+}
+
+#endif
+
+static int steal_one( Worker *self, Worker * victim, _wool_task_header_t card, int flags, volatile Task *jt, unsigned long ssn )
+{
+#if WOOL_RECV_INIT
+  int steal_outcome = ri_steal( self, victim, card, flags, jt );
+#elif CHASE_LEV_SYNC
+  int steal_outcome = cl_steal( self, victim, card, flags, jt, ssn );
+#else
+  Worker* v[] = {victim, victim};
+  int steal_outcome = steal( self, v, card, flags, jt, ssn );
+#endif
+
+  #if COUNT_EVENTS
+    PR_INC( self, CTR_leap_tries );
+    if( steal_outcome == SO_STOLE ) {
+      PR_INC( self, CTR_leaps );
+    } else if( steal_outcome == SO_BUSY ) {
+      PR_INC( self, CTR_leap_locks );
+    }
+  #endif
+
+  return steal_outcome;
+}
+
+static int myrand( unsigned int *seedp, int max )
+{
+  return rand_r( seedp ) % max;
+}
+
+// One steal attempt from a random victim by a worker that waits for a
+// future. As when leapfrogging, the booty runs on top of the pool of the
+// waiter, so the card records the current top.
+static int steal_while_waiting( Worker *self, unsigned int *seedp )
+{
+  int n = n_workers, self_idx = self->pr.idx;
+  _wool_task_header_t card;
+  Worker *victim;
+
+  ri_answer( self, 0 );
+  if( WOOL_FIXED_STEAL || n < 2 ) {
+    return 0;
+  }
+  victim = workers[ ( self_idx + 1 + myrand( seedp, n-1 ) ) % n ];
+  card = SFS_STOLEN( MAKE_THIEF_INFO( self_idx, ptr2idx_curr( self, self->pr.pr_top ) ) );
+  return steal_one( self, victim, card, 0, NULL, 0 ) == SO_STOLE;
+}
+
+static int rand_interval = 40; // By default, scan sequentially for 0..39 attempts
+
+#define to_widx(n,i) ( (n)>(i) ? (i) : (n) > (i)-(n) ? (i)-(n) : (i)%(n) )
+// #define to_widx(n,i) ( (i)%(n) )
+
+#define BITS_PER_LONG  ( sizeof(long)*8 )
+#define WORD(m,i) ( m[(i)/BITS_PER_LONG] )
+#define BIT(i) (1<<((i)%BITS_PER_LONG))
+
+static inline int record_steal( Worker *self, int n, int attempts, int steal_outcome )
+{
+
+  if( steal_outcome == SO_BUSY ) {
+    PR_INC( self, CTR_steal_locks );
+  }
+  if( steal_outcome == SO_STOLE ) {
+    PR_INC( self, CTR_steals );
+
+    // Ok, this is clunky, but the idea is to record if we had to try many times
+    // before we managed to steal.
+
+    #if !WOOL_PIE_TIMES
+    if( attempts == 1 ) {
+      PR_INC( self, CTR_steal_1s );
+      PR_ADD( self, CTR_steal_1t, attempts );
+    } else if( attempts < n ) {
+      PR_INC( self, CTR_steal_ps );
+      PR_ADD( self, CTR_steal_pt, attempts );
+    } else if( attempts < 3*n ) {
+      PR_INC( self, CTR_steal_hs );
+      PR_ADD( self, CTR_steal_ht, attempts );
+    } else {
+      PR_INC( self, CTR_steal_ms );
+      PR_ADD( self, CTR_steal_mt, attempts );
+    }
+    #endif
+    return 0;
+  } else {
+    return attempts;
+  }
+}
+
+static int global_poll_size = 0;
+#if WOOL_STEAL_SAMPLE
+static int poll_size_option = 0; // As given by '-g'
+#endif
+
+static inline TILE_INLINE int task_appears_stealable( Task *p )
+{
+  #if WOOL_RECV_INIT
+    // Private tasks are never free, and an old header may linger above top,
+    // so this is only a hint that asking the owner is worthwhile
+    return SFS_IS_TASK( p->hdr );
+  #elif CHASE_LEV_SYNC
+    return SFS_IS_TASK( p->hdr ); // Below cl_top, see poll()
+  #elif TWO_FIELD_SYNC
+    return p->balarm != TF_OCC && ( !_WOOL_ordered_stores || SFS_IS_TASK( p->hdr ) );
+  #elif THE_SYNC
+    return p->stealable && p->balarm == NOT_STOLEN && p->hdr > T_LAST;
+  #else
+    return p->stealable && p->hdr > T_LAST;
+  #endif
+}
+
+// With cost hints, a task with a hint ranks before any without, larger
+// hints first; tasks without a hint rank by depth as usual.
+#define COST_RANK_MAX (1L << 24)
+
+static int poll_rank( Task *p, int depth )
+{
+  #if WOOL_COST_HINTS
+    long c = p->cost;
+
+    if( c > 0 ) {
+      return (int) ( COST_RANK_MAX - ( c < COST_RANK_MAX ? c : COST_RANK_MAX ) );
+    }
+    return (int) COST_RANK_MAX + depth;
+  #else
+    return depth;
+  #endif
+}
+
+static int poll( Worker *w )
+{
+  long unsigned  bot      = _WOOL_BOT_IDX( w->pu.dq_bot );
+  Task          *base     = w->pu.pu_blocks->block[0];
+  int            depth    = w->pu.flag;
+  Task          *p;
+
+  #if WOOL_STEAL_SET
+    if( w->pu.is_thief ) {
+      return -2;
+    }
+    #if WOOL_FAST_SAMPLING
+      return depth + bot;
+    #endif
+  #endif
+
+  #if CHASE_LEV_SYNC
+    if( bot >= w->pu.cl_top ) {
+      return -1;
+    }
+  #endif
+
+  p = idx_to_task_p_pu( w, bot, base );
+  if( p != NULL && task_appears_stealable( p ) ) {
+    return poll_rank( p, depth + bot );
+  } else {
+    return -1;
+  }
+}
+
+#if WOOL_AFFINITY
+
+static int mail_patience = 1000; // Rounds spent waiting for a mailed task, set by '-M'
+
+// A letter names a task by its owner and its pool index. Each mailbox
+// holds only the latest letter; older ones are overwritten.
+#define LETTER( from, idx ) ( ( (unsigned long) (idx) << 16 ) | (unsigned long) ( (from) + 1 ) )
+#define LETTER_FROM( l )    ( (int) ( (l) & 0xffff ) - 1 )
+#define LETTER_IDX( l )     ( (l) >> 16 )
+
+void _WOOL_(post_mail)( Worker *self, int to, unsigned long idx )
+{
+  int from = self->pr.idx;
+
+  if( to >= 0 && to < n_workers && to != from && from < 0xffff ) {
+    if( !_WOOL_ordered_stores ) {
+      SFENCE; // The task before the letter
+    }
+    workers[to]->pu.mailbox = LETTER( from, idx );
+    PR_INC( self, CTR_mailed );
+  }
+}
+
+// Called by an idle worker before it steals. The mailed task is stolen
+// when it is at the bottom of its owner's pool; SO_BUSY means that it is
+// public and still further up, SO_NO_WORK that it is not worth waiting for.
+// The letter is dropped once the task has left [bot,top), stolen or joined.
+static int read_mail( Worker *self, _wool_task_header_t card )
+{
+  unsigned long letter = self->pu.mailbox;
+  unsigned long idx = LETTER_IDX( letter );
+  Worker *v[2];
+  unsigned long bot;
+  Task *p;
+  int steal_outcome;
+
+  v[0] = v[1] = workers[ LETTER_FROM( letter ) ];
+  bot = _WOOL_BOT_IDX( v[0]->pu.dq_bot );
+  if( bot <= idx && idx >= v[0]->pu.pu_n_public ) {
+    return SO_NO_WORK; // Still private; steal elsewhere, but keep the letter
+  }
+  p = bot <= idx ? idx_to_task_p_pu( v[0], idx, v[0]->pu.pu_blocks->block[0] ) : NULL;
+  if( p == NULL || !task_appears_stealable( p ) ) {
+    __sync_bool_compare_and_swap( &( self->pu.mailbox ), letter, 0 );
+    return SO_NO_WORK;
+  }
+  if( bot < idx ) {
+    return SO_BUSY;
+  }
+  steal_outcome = steal( self, v, card, ST_THIEF | ST_MAIL, NULL, 0 );
+  if( steal_outcome == SO_STOLE ) {
+    __sync_bool_compare_and_swap( &( self->pu.mailbox ), letter, 0 );
+    PR_INC( self, CTR_mail_steals );
+  }
+  return steal_outcome;
+}
+
+#endif
+
+static int work_visible( Worker *self )
+{
+  int i;
+
+  if( inject_pending() ) {
+    return 1;
+  }
+  for( i = 0; i < n_workers; i++ ) {
+    if( workers[i] != self && poll( workers[i] ) >= 0 ) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+// Returns nonzero if the worker was woken or saw work, zero if it timed out
+
+static int park( Worker *self, int timeout_us )
+{
+  int key = park_seq;
+  int i, woken = 1;
+  #if COUNT_EVENTS
+    long long unsigned t0 = ns_now(), t1;
+  #endif
+
+  self->pu.parked = 1;
+  __sync_fetch_and_add( &n_parked, 1 ); // Full fence
+
+  // Have busy workers look for sleepers at their next spawn
+  for( i = 0; i < n_workers; i++ ) {
+    if( workers[i] != self && !workers[i]->pu.parked ) {
+      throw_spawn_exception( workers[i] );
+    }
+  }
+
+  if( self->pr.more_work > 1 && !work_visible( self ) ) {
+    PR_INC( self, CTR_parks );
+    futex_wait( &park_seq, key, timeout_us );
+    woken = park_seq != key;
+    #if COUNT_EVENTS
+      t1 = ns_now();
+      PR_ADD( self, CTR_park_us, ( t1 - t0 ) / 1000 );
+      if( woken ) {
+        PR_ADD( self, CTR_wake_ns, t1 > last_wake_ns ? t1 - last_wake_ns : 0 );
+      }
+    #endif
+  }
+
+  __sync_fetch_and_sub( &n_parked, 1 );
+  self->pu.parked = 0;
+  return woken;
+}
+
+#if WOOL_STEAL_NEW_SET
+static int hier_rounds = 2; // Passes over a level before going further away, set by '-H'
+#endif
+
+#if WOOL_STEAL_NEW_SET
+static int global_max_thieves = 4,
+           global_min_set_size = 12;
+#endif
+
+static int global_max_fail_while_sampling =
+              WOOL_STEAL_SAMPLE && WOOL_STEAL_NEW_SET ? 1 : 0;
+static int global_max_fail_while_searching =
+              WOOL_STEAL_SAMPLE && WOOL_STEAL_NEW_SET ? 1 : 0;
+
+#if WOOL_STEAL_NEW_SET
+
+// look_for_work() picks its victims through a policy, chosen with
+// '-V <name>'. A policy orders the other workers once (start) and picks
+// the next victim after every steal attempt (next); sampling policies
+// poll a few victims before each steal and rob the most promising one.
+
+typedef struct {
+  Worker     **scramble;        // The victims in policy order, with a cyclic suffix
+  int          n_active;        // Only the first n_active victims are searched
+  int          first_victim;    // The start of the current set
+  int          n_seen;
+  int          n_thieves;
+  int          since_rand;
+  unsigned int seed;
+  int          level_end[DIST_CLASSES]; // Victims closer than each distance class
+  int          level;
+  int          first_level;
+  int          level_fails;
+  int          self_idx;
+} victim_state_t;
+
+typedef struct {
+  const char *name;
+  int         sample;
+  int       (*start)( victim_state_t *, int self_idx, int n ); // Returns the first victim
+  int       (*next)( victim_state_t *, int i, int steal_outcome );
+} victim_policy_t;
+
+// Sets of consecutive victims in a random order. After a steal, a new
+// set starts at a random victim; otherwise the set is restarted when
+// enough of its members were thieves themselves.
+
+static int set_start( victim_state_t *vs, int self_idx, int n )
+{
+  Worker **scramble = vs->scramble;
+  int j;
+
+  for( j=0; j<n-1; j++ ) {
+    scramble[j] = j < self_idx ? workers[j] : workers[j+1];
+  }
+  for( j=0; j<n-1; j++ ) {
+    Worker* tmp = scramble[j];
+    int other = myrand( &vs->seed, n-1 );
+    scramble[j] = scramble[other];
+    scramble[other] = tmp;
+  }
+  // Finally, add cyclic suffix
+  for( j=n-1; j<n-1+parsamp_size; j++ ) {
+    scramble[j] = scramble[j-(n-1)];
+  }
+  vs->n_active = n-1;
+  vs->first_victim = vs->n_seen = vs->n_thieves = vs->since_rand = 0;
+  return 0;
+}
+
+static int set_next( victim_state_t *vs, int i, int steal_outcome )
+{
+  const int max_rand_interval = 1000;
+  int j;
+
+  if( steal_outcome == SO_STOLE ) {
+    #if WOOL_STEAL_SAMPLE && WOOL_STEAL_BACK
+      i-= global_min_set_size/2;
+      if( i<0 ) i+=vs->n_active;
+      vs->first_victim = i;
+    #else
+      i = vs->first_victim = myrand( &vs->seed, vs->n_active );
+      vs->since_rand = 0;
+    #endif
+    vs->n_seen = vs->n_thieves = 0;
+    return i;
+  }
+  if( SO_IS_FAIL(steal_outcome) ) {
+    vs->n_thieves += SO_NUM_THIEVES(steal_outcome);
+  }
+  vs->n_seen+=1+parsamp_size;
+  if( vs->n_seen > global_min_set_size && vs->n_thieves >= global_max_thieves ) {
+    // Start from the beginning of our set
+    i = vs->first_victim;
+    vs->since_rand += vs->n_seen;
+    vs->n_seen = vs->n_thieves = 0;
+    // Check if we should do a new set
+    if( vs->since_rand > max_rand_interval ) {
+      vs->first_victim = i = myrand( &vs->seed, vs->n_active );
+      vs->since_rand = 0;
+    }
+  } else {
+    // Continue within the set
+    for( j=0; j<parsamp_size+1; j++ ) {
+      i++;
+      if( i>vs->n_active-1 ) i = 0;
+      if( i==vs->first_victim ) {
+        vs->n_thieves = vs->n_seen = 0;
+      }
+    }
+  }
+  return i;
+}
+
+// A new random victim for every attempt.
+
+static int random_start( victim_state_t *vs, int self_idx, int n )
+{
+  set_start( vs, self_idx, n );
+  return myrand( &vs->seed, vs->n_active );
+}
+
+static int random_next( victim_state_t *vs, int i, int steal_outcome )
 {
-  Worker* v[] = {victim, victim};
-  int steal_outcome = steal( self, v, card, flags, jt, ssn );
+  return myrand( &vs->seed, vs->n_active );
+}
 
-  #if COUNT_EVENTS
-    PR_INC( self, CTR_leap_tries );
-    if( steal_outcome == SO_STOLE ) {
-      PR_INC( self, CTR_leaps );
-    } else if( steal_outcome == SO_BUSY ) {
-      PR_INC( self, CTR_leap_locks );
-    }
-  #endif
+#if !WOOL_STEAL_PARSAMP
 
-  return steal_outcome;
+// Sets as above, but among the nearest victims first. The search goes
+// further away after hier_rounds fruitless passes over the current
+// level, and comes back to the nearest level on success.
+
+static int hier_start( victim_state_t *vs, int self_idx, int n )
+{
+  Worker **scramble = vs->scramble;
+  int i = 0, j;
+
+  set_start( vs, self_idx, n );
+  // Sort the victims on distance; insertion sort is stable, so each class
+  // stays randomized.
+  for( j=1; j<n-1; j++ ) {
+    Worker *tmp = scramble[j];
+    int d = worker_distance( self_idx, tmp->pr.idx ), k;
+    for( k = j; k > 0 && worker_distance( self_idx, scramble[k-1]->pr.idx ) > d; k-- ) {
+      scramble[k] = scramble[k-1];
+    }
+    scramble[k] = tmp;
+  }
+  for( j=0; j<DIST_CLASSES; j++ ) {
+    int k;
+    vs->level_end[j] = 0;
+    for( k=0; k<n-1; k++ ) {
+      if( worker_distance( self_idx, scramble[k]->pr.idx ) <= j ) vs->level_end[j]++;
+    }
+  }
+  vs->first_level = 0;
+  while( vs->first_level < DIST_CLASSES-1 && vs->level_end[vs->first_level] == 0 ) {
+    vs->first_level++;
+  }
+  vs->level = vs->first_level;
+  vs->level_fails = 0;
+  vs->n_active = vs->level_end[vs->level];
+  if( vs->n_active > 0 ) {
+    i = vs->first_victim = myrand( &vs->seed, vs->n_active );
+  }
+  return i;
 }
 
-static int myrand( unsigned int *seedp, int max )
+static int hier_next( victim_state_t *vs, int i, int steal_outcome )
 {
-  return rand_r( seedp ) % max;
+  if( steal_outcome == SO_STOLE ) {
+    vs->level = vs->first_level;
+    vs->level_fails = 0;
+    vs->n_active = vs->level_end[vs->level];
+  } else if( ++vs->level_fails > hier_rounds * vs->n_active && vs->level < DIST_CLASSES-1 ) {
+    do {
+      vs->level++;
+    } while( vs->level < DIST_CLASSES-1 && vs->level_end[vs->level] == vs->n_active );
+    vs->level_fails = 0;
+    vs->n_active = vs->level_end[vs->level];
+  }
+  return set_next( vs, i, steal_outcome );
 }
 
-static int rand_interval = 40; // By default, scan sequentially for 0..39 attempts
+#endif
 
-#define to_widx(n,i) ( (n)>(i) ? (i) : (n) > (i)-(n) ? (i)-(n) : (i)%(n) )
-// #define to_widx(n,i) ( (i)%(n) )
+#if WOOL_STEAL_BOARD
 
-#define BITS_PER_LONG  ( sizeof(long)*8 )
-#define WORD(m,i) ( m[(i)/BITS_PER_LONG] )
-#define BIT(i) (1<<((i)%BITS_PER_LONG))
+// Marked workers on the steal board first, scanning the board from the
+// current victim; sets in worker order when the board is empty. A victim
+// found empty is cleared from the board, one that had work is marked.
 
-static inline int record_steal( Worker *self, int n, int attempts, int steal_outcome )
+static int board_start( victim_state_t *vs, int self_idx, int n )
 {
+  Worker **scramble = vs->scramble;
+  int j;
 
-  if( steal_outcome == SO_BUSY ) {
-    PR_INC( self, CTR_steal_locks );
+  set_start( vs, self_idx, n );
+  for( j=0; j<n-1; j++ ) {
+    scramble[j] = workers[ ( self_idx + 1 + j ) % n ];
   }
-  if( steal_outcome == SO_STOLE ) {
-    PR_INC( self, CTR_steals );
+  for( j=n-1; j<n-1+parsamp_size; j++ ) {
+    scramble[j] = scramble[j-(n-1)];
+  }
+  vs->self_idx = self_idx;
+  return 0;
+}
 
-    // Ok, this is clunky, but the idea is to record if we had to try many times
-    // before we managed to steal.
+static int board_next( victim_state_t *vs, int i, int steal_outcome )
+{
+  int n = vs->n_active + 1, k;
 
-    #if !WOOL_PIE_TIMES
-    if( attempts == 1 ) {
-      PR_INC( self, CTR_steal_1s );
-      PR_ADD( self, CTR_steal_1t, attempts );
-    } else if( attempts < n ) {
-      PR_INC( self, CTR_steal_ps );
-      PR_ADD( self, CTR_steal_pt, attempts );
-    } else if( attempts < 3*n ) {
-      PR_INC( self, CTR_steal_hs );
-      PR_ADD( self, CTR_steal_ht, attempts );
-    } else {
-      PR_INC( self, CTR_steal_ms );
-      PR_ADD( self, CTR_steal_mt, attempts );
+  if( steal_outcome == SO_NO_WORK || steal_outcome == SO_THIEF ) {
+    board_clear( vs->scramble[i] );
+  } else if( steal_outcome == SO_STOLE ) {
+    board_mark( vs->scramble[i] );
+  }
+  for( k = steal_outcome == SO_STOLE ? 0 : 1; k < n; k++ ) {
+    int p = ( i + k ) % vs->n_active;
+
+    if( steal_board[ ( vs->self_idx + 1 + p ) % n ] ) {
+      return p;
     }
-    #endif
-    return 0;
-  } else {
-    return attempts;
   }
+  return set_next( vs, i, steal_outcome );
 }
 
-static int global_poll_size = 0;
+#endif
 
-static inline TILE_INLINE int task_appears_stealable( Task *p )
-{
-  #if TWO_FIELD_SYNC
-    return p->balarm != TF_OCC && ( !_WOOL_ordered_stores || SFS_IS_TASK( p->hdr ) );
-  #elif THE_SYNC
-    return p->stealable && p->balarm == NOT_STOLEN && p->hdr > T_LAST;
-  #else
-    return p->stealable && p->hdr > T_LAST;
-  #endif
-}
+static victim_policy_t victim_policies[] = {
+#if WOOL_STEAL_SAMPLE
+  { "sample", 1, set_start, set_next },
+#endif
+  { "set", 0, set_start, set_next },
+  { "random", 0, random_start, random_next },
+#if !WOOL_STEAL_PARSAMP
+  { "hier", WOOL_STEAL_SAMPLE, hier_start, hier_next },
+#endif
+#if WOOL_STEAL_BOARD
+  { "board", 0, board_start, board_next },
+#endif
+  { NULL, 0, NULL, NULL }
+};
 
-static int poll( Worker *w )
+static const char *victim_policy_name = WOOL_STEAL_HIER ? "hier" : NULL; // Set by '-V'
+static victim_policy_t *victim_policy = victim_policies;
+
+static void choose_victim_policy( void )
 {
-  long unsigned  bot      = w->pu.dq_bot;
-  Task          *base     = w->pu.pu_block_base[0];
-  int            depth    = w->pu.flag;
-  Task          *p;
+  victim_policy_t *p;
 
-  #if WOOL_STEAL_SET
-    if( w->pu.is_thief ) {
-      return -2;
-    }
-    #if WOOL_FAST_SAMPLING
-      return depth + bot;
-    #endif
+  victim_policy = victim_policies;
+  #if WOOL_STEAL_BOARD
+    board_in_use = 0;
   #endif
-
-  p = idx_to_task_p_pu( w, bot, base );
-  if( p != NULL && task_appears_stealable( p ) ) {
-    return depth + bot;
-  } else {
-    return -1;
+  if( victim_policy_name == NULL ) {
+    return;
   }
+  for( p = victim_policies; p->name != NULL; p++ ) {
+    if( !strcmp( victim_policy_name, p->name ) ) {
+      victim_policy = p;
+      #if WOOL_STEAL_BOARD
+        board_in_use = p->start == board_start;
+      #endif
+      return;
+    }
+  }
+  fprintf( stderr, "Wool: unknown victim policy '%s', using '%s'\n",
+                   victim_policy_name, victim_policy->name );
 }
 
-#if WOOL_STEAL_NEW_SET
-static int global_max_thieves = 4,
-           global_min_set_size = 12;
 #endif
 
-static int global_max_fail_while_sampling =
-              WOOL_STEAL_SAMPLE && WOOL_STEAL_NEW_SET ? 1 : 0;
-static int global_max_fail_while_searching =
-              WOOL_STEAL_SAMPLE && WOOL_STEAL_NEW_SET ? 1 : 0;
-
 // There are three phases in look_for_work regardless of configuration:
 //
 //   1) Prepare for stealing.
@@ -2868,14 +4977,8 @@ static void *look_for_work( void *arg )
   int next_spin = n-1;
   volatile int v = 0; // To ensure that a delay loop is executed
 #if WOOL_STEAL_NEW_SET
-  int since_rand = 0;
-  const int max_rand_interval = 1000;
-  // State related to set stealing
-  int n_seen = 0,
-      n_thieves = 0,
-      first_victim = 0;
-  int min_set_size = global_min_set_size,
-      max_thieves = global_max_thieves;
+  const victim_policy_t *policy = victim_policy;
+  victim_state_t vs;
 #endif
 
   // State related to sampling
@@ -2885,40 +4988,79 @@ static void *look_for_work( void *arg )
   int poll_size = global_poll_size;
   int polling = max_fail_while_searching;
   int v_depth = v_depth_default;
+  int idle_rounds = 0;
+  int park_us = park_timeout;
+#if WOOL_AFFINITY
+  int mail_waits = 0;
+  unsigned long last_letter = 0;
+#endif
+
+  int v_class[n-1+parsamp_size];
 
   if( 0 && self_idx % 4 == 1 ) {
     polling = max_fail_while_searching = 1000;
   }
 
-  for( j=0; j<n-1; j++ ) {
-    scramble[j] = j < self_idx ? workers[j] : workers[j+1];
-  }
 #if WOOL_STEAL_NEW_SET
-  // Use the scramble array in every code path. Only scramble the
-  // array if set based stealing is enabled though.
-  for( j=0; j<n-1; j++ ) {
-    Worker* tmp = scramble[j];
-    int other = myrand( &seed, n-1 );
-    scramble[j] = scramble[other];
-    scramble[other] = tmp;
-  }
-  // Finally, add cyclic suffix
-  for( j=n-1; j<n-1+parsamp_size; j++ ) {
-    scramble[j] = scramble[j-(n-1)];
+  // The policy orders the scramble array
+  vs.scramble = scramble;
+  vs.seed = seed;
+  if( !policy->sample ) {
+    polling = max_fail_while_sampling = max_fail_while_searching = 0;
   }
+  i = policy->start( &vs, self_idx, n );
 
 #if !WOOL_STEAL_SAMPLE
   self->pu.is_thief = 1;
 #endif
-
+#else
+  for( j=0; j<n-1; j++ ) {
+    scramble[j] = j < self_idx ? workers[j] : workers[j+1];
+  }
 #endif
 
+  for( j=0; j<n-1+parsamp_size; j++ ) {
+    v_class[j] = worker_distance( self_idx, scramble[j]->pr.idx );
+  }
+
   do {
     int steal_outcome = SO_NO_WORK;
     int poll_outcome = 0;
     int poll_ctr = 0;
     int skip_steal = 0;
 
+    // Our pool is empty, so a thief asking us gets nothing
+    ri_answer( self, 0 );
+
+    // Work submitted from outside the pool goes before stealing
+    if( inject_pending() && run_one_injected( self ) ) {
+      idle_rounds = 0;
+      park_us = park_timeout;
+      self->pr.trim_pending = 1;
+    }
+    #if WOOL_AFFINITY
+      // Then tasks mailed to us; while one is on its way down the pool of
+      // its owner, we do not steal anything else for a while. Each new
+      // letter gets mail_patience rounds of its own.
+      if( self->pu.mailbox != last_letter ) {
+        last_letter = self->pu.mailbox;
+        mail_waits = 0;
+      }
+      if( last_letter != 0 ) {
+        int mail_outcome = read_mail( self, card );
+
+        if( mail_outcome == SO_STOLE ) {
+          idle_rounds = 0;
+          park_us = park_timeout;
+          self->pr.trim_pending = 1;
+          mail_waits = 0;
+        } else if( mail_outcome == SO_BUSY && mail_waits < mail_patience ) {
+          mail_waits++;
+          skip_steal = 1;
+        }
+      }
+    #endif
+
     /*
      * Preparatory phase.
      */
@@ -3004,7 +5146,7 @@ static void *look_for_work( void *arg )
      */
 
     // Always true for non-sampling versions.
-    if( !( WOOL_STEAL_SAMPLE && WOOL_STEAL_NEW_SET ) ||
+    if( ( !( WOOL_STEAL_SAMPLE && WOOL_STEAL_NEW_SET ) && !skip_steal ) ||
 	( !skip_steal && ( poll_ctr == poll_size || polling == 0 ) ) ) {
       if( poll_ctr<0 || poll_ctr > poll_size ) dprint( "Unexpected poll_ctr = %d\n", poll_ctr );
 #if !(WOOL_STEAL_SAMPLE && WOOL_STEAL_NEW_SET)
@@ -3013,7 +5155,20 @@ static void *look_for_work( void *arg )
 
       // Now steal
       PR_INC( self, CTR_steal_tries );
-      steal_outcome = steal( self, scramble+v_pos, card, is_old_thief | ST_THIEF, NULL, 0 );
+      #if WOOL_RECV_INIT
+        steal_outcome = ri_steal( self, scramble[v_pos], card, is_old_thief | ST_THIEF, NULL );
+      #elif CHASE_LEV_SYNC
+        steal_outcome = cl_steal( self, scramble[v_pos], card, is_old_thief | ST_THIEF, NULL, 0 );
+      #else
+        steal_outcome = steal( self, scramble+v_pos, card, is_old_thief | ST_THIEF, NULL, 0 );
+      #endif
+      if( COUNT_EVENTS && steal_outcome == SO_STOLE ) {
+        if( v_class[v_pos] == DIST_CLASSES-1 ) {
+          PR_INC( self, CTR_steal_remote );
+        } else {
+          PR_INC( self, CTR_steal_local );
+        }
+      }
 
       attempts++;
       attempts = record_steal( self, n, attempts, steal_outcome );
@@ -3031,52 +5186,43 @@ static void *look_for_work( void *arg )
      * Post-steal phase.
      */
 
-    // Now find the next index
     if( steal_outcome == SO_STOLE ) {
+      idle_rounds = 0;
+      park_us = park_timeout;
+      self->pr.trim_pending = 1;
+    } else if( ++idle_rounds >= park_interval ) {
+      // After some work, park_interval fruitless rounds are a quiet
+      // period, also when we do not park
+      if( self->pr.trim_pending ) {
+        trim_worker( self );
+      }
+      if( !WOOL_IDLE_PARK ) {
+        idle_rounds = park_interval;
+      } else if( park( self, park_us ) ) {
+        idle_rounds = 0;
+        park_us = park_timeout;
+      } else {
+        // Still nothing to do, so go back to sleep after this round
+        idle_rounds = park_interval - 1;
+        park_us = park_us < park_timeout_max / 2 ? 2 * park_us : park_timeout_max;
+      }
+    }
+
+    // Now find the next index
 #if WOOL_STEAL_NEW_SET
-      #if WOOL_STEAL_SAMPLE && WOOL_STEAL_BACK
-        i-= min_set_size/2;
-        if( i<0 ) i+=n-1;
-        first_victim = i;
-      #else
-        i = first_victim = myrand( &seed, n-1 );
-        since_rand = 0;
-      #endif
-      n_seen = n_thieves = 0;
+    i = policy->next( &vs, i, steal_outcome );
+    if( steal_outcome == SO_STOLE ) {
       self->pu.is_thief = 1;
+    }
 #else
+    if( steal_outcome == SO_STOLE ) {
       next_yield = yield_interval;
       next_sleep = sleep_interval;
       next_spin = n-1;
       local_sleep_interval = sleep_interval;
       is_old_thief = 0;
-#endif
-    } else if ( WOOL_STEAL_NEW_SET ) {
-      if( SO_IS_FAIL(steal_outcome) ) {
-        n_thieves += SO_NUM_THIEVES(steal_outcome);
-      }
-      n_seen+=1+parsamp_size;
-      if( n_seen > min_set_size && n_thieves >= max_thieves ) {
-        // Start from the beginning of our set
-        i = first_victim;
-        since_rand += n_seen;
-        n_seen = n_thieves = 0;
-        // Check if we should do a new set
-        if( since_rand > max_rand_interval ) {
-          first_victim = i = myrand( &seed, n-1 );
-          since_rand = 0;
-        }
-      } else {
-        // Continue within the set
-        for( j=0; j<parsamp_size+1; j++ ) {
-          i++;
-          if( i>n-2 ) i = 0;
-          if( i==first_victim ) {
-            n_thieves = n_seen = 0;
-          }
-        }
-      }
     }
+#endif
     #if WOOL_STEAL_NEW_SET && !WOOL_STEAL_SAMPLE
       victim_idx = i;
     #endif
@@ -3109,15 +5255,18 @@ static void *do_work( void *arg )
     (*self_p)->pr.time = gethrtime();
   #endif
 
+  // Between calls of fun (eg while the pool is suspended), the worker waits
+  // here with work_lock released. Wakeups without a new fun are ignored.
   wool_lock( &( (*self_p)->pu.work_lock )  );
-  if( (*self_p)->pu.fun == NULL && (*self_p)->pr.more_work > 0 ) {
-    pthread_cond_wait( &( (*self_p)->pu.work_available ), &( (*self_p)->pu.work_lock ) );
-  }
-
-  while( (*self_p)->pr.more_work > 0 ) {
+  while( 1 ) {
+    while( (*self_p)->pu.fun == NULL && (*self_p)->pr.more_work > 0 ) {
+      pthread_cond_wait( &( (*self_p)->pu.work_available ), &( (*self_p)->pu.work_lock ) );
+    }
+    if( (*self_p)->pr.more_work == 0 ) {
+      break;
+    }
     (*self_p)->pu.fun( (*self_p)->pu.fun_arg );
     (*self_p)->pu.fun = NULL;
-    pthread_cond_wait( &( (*self_p)->pu.work_available ), &( (*self_p)->pu.work_lock ) );
   }
   wool_unlock( &( (*self_p)->pu.work_lock ) );
 
@@ -3225,6 +5374,21 @@ char *ctr_h[] = {
 #endif
   "   trlf",
   "trlf_iters",
+  " Inject",
+  "  Parks",
+  "  Wakes",
+  " Park_us",
+  "Wake_ns",
+  " Loc_st",
+  " Rem_st",
+  "  Grown",
+  "  Trims",
+  "Pool_KB",
+  "  JS_KB",
+  "Batched",
+  "   Lazy",
+  " Mailed",
+  " MailSt",
 };
 
 #else
@@ -3295,6 +5459,21 @@ char *ctr_h[] = {
 #endif
   "   trlf",
   "trlf_iters",
+  " Inject",
+  "  Parks",
+  "  Wakes",
+  " Park_us",
+  "Wake_ns",
+  " Loc_st",
+  " Rem_st",
+  "  Grown",
+  "  Trims",
+  "Pool_KB",
+  "  JS_KB",
+  "Batched",
+  "   Lazy",
+  " Mailed",
+  " MailSt",
 };
 
 #endif
@@ -3317,9 +5496,123 @@ static void signal_worker_shutdown( void )
     //  Signal the worker to release it.
     pthread_cond_signal( &( workers[i]->pu.work_available) );
   }
+  wake_all();
   WOOL_WHEN_SYNC_MORE( wool_unlock( &more_lock ); )
 }
 
+// Persistent pool mode: wool_suspend() parks all workers but the calling
+// one (worker 0, outside of any task) in do_work() and wool_resume() sends
+// them stealing again. Threads and pools are kept in between.
+void wool_suspend( void )
+{
+  int i;
+
+  for( i = 1; i < n_workers; i++ ) {
+    // Quit look_for_work(), but not do_work()
+    workers[i]->pr.more_work = 1;
+  }
+  wake_all();
+  wool_lock( &sleep_lock );
+    wool_broadcast( &sleep_cond );
+  wool_unlock( &sleep_lock );
+  for( i = workers_per_thread; i < n_workers; i += workers_per_thread ) {
+    // The thread leader holds work_lock until it is back waiting for work
+    wool_lock( &( workers[i]->pu.work_lock ) );
+    wool_unlock( &( workers[i]->pu.work_lock ) );
+  }
+  // Nobody is stealing now, so every pool can shrink
+  for( i = 0; i < n_workers; i++ ) {
+    trim_worker( workers[i] );
+    free_older_tables( workers[i] );
+  }
+}
+
+void wool_resume( void )
+{
+  int i;
+
+  for( i = 1; i < n_workers; i++ ) {
+    workers[i]->pr.more_work = 2;
+  }
+  work_for( (workfun_t) look_for_work, NULL );
+}
+
+static void fini_worker( int w_idx )
+{
+  Worker *w = workers[w_idx];
+  int i;
+
+  for( i = 0; i < w->pr.n_blocks; i++ ) {
+    Task *b = w->pr.block_base[i];
+    // The first block is allocated with the worker, but may have moved
+    if( b != NULL && b != w->pr.dq_base ) {
+      free_aligned( b, block_size( i ) * sizeof(Task) );
+    }
+  }
+#if WOOL_JOIN_STACK
+  for( i = 0; i < w->pr.n_spare; i++ ) {
+    free_aligned( w->pr.spare_blocks[i], first_block_size * sizeof(Task) );
+  }
+#else
+  for( i = 0; i < w->pr.n_blocks; i++ ) {
+    if( w->pr.spare_blocks[i] != NULL ) {
+      free_aligned( w->pr.spare_blocks[i], block_size( i ) * sizeof(Task) );
+    }
+  }
+#endif
+  free( w->pr.spare_blocks );
+  free( w->pr.block_base );
+  free_older_tables( w );
+  free( w->pu.pu_blocks );
+  free_aligned( spill_base( w ), spill_size );
+#if WOOL_JOIN_STACK
+  free_aligned( w->pr.join_stack_base, join_stack_size * sizeof(Task) );
+#endif
+#if LOG_EVENTS
+  free( logbuff[w_idx] );
+#endif
+#if THREAD_GARAGE
+  pthread_mutex_destroy( &(garage[w_idx].lck) );
+  pthread_cond_destroy( &(garage[w_idx].cnd) );
+#endif
+  pthread_mutex_destroy( w->pu.dq_lock );
+  pthread_mutex_destroy( &( w->pu.work_lock ) );
+  pthread_cond_destroy( &( w->pu.work_available ) );
+  free_aligned( ( (char *) w ) - w_idx * worker_offset,
+                sizeof(Worker) + first_block_size * sizeof(Task) + w_idx * worker_offset );
+}
+
+// Return all memory and reset the global state so that the runtime
+// can be started again.
+static void release_pool( void )
+{
+  int i;
+
+  for( i = 0; i < n_workers; i++ ) {
+    fini_worker( i );
+  }
+  free_aligned( workers, 2 * n_workers * sizeof(void *) );
+  workers = NULL;
+  bases   = NULL;
+  free( ts );
+  ts = NULL;
+#if THREAD_GARAGE
+  free( garage );
+  garage = NULL;
+#endif
+#if WOOL_INIT_SPIN
+  free( (void *) init_barrier );
+  init_barrier = NULL;
+#else
+  n_initialized = 0;
+#endif
+  pthread_attr_destroy( &worker_attr );
+  old_thieves = 0;
+  inject_ready = 0;
+  _WOOL_(setspecific)( &tls_self, NULL );
+  n_workers = n_threads = 0;
+}
+
 void wool_fini( void )
 {
   int i;
@@ -3343,6 +5636,9 @@ void wool_fini( void )
     last_time -= first_time;
   #endif
 
+  // Nobody may be left waiting for work that was submitted but not started
+  while( run_one_injected( workers[0] ) ) ;
+
   signal_worker_shutdown();
   // fprintf( stderr, "Exiting with thread leader %d\n", workers[0]->thread_leader  );
   // More work is false here
@@ -3550,6 +5846,7 @@ void wool_fini( void )
     fclose( log_file );
   }
 
+  release_pool();
 }
 
 // Starts the runtime system with workstealing if start_ws is true.
@@ -3567,6 +5864,8 @@ static void rts_init_start( int start_ws )
 
   // fprintf( stderr, "Entering \n" );
 
+  // Derived parameters are recomputed for every start since n_procs may change
+  n_stealable = n_stealable_option;
   if( n_stealable == -1 ) {
     n_stealable = 3;
     for( i=n_procs; i>0; i >>= 1 ) {
@@ -3577,6 +5876,13 @@ static void rts_init_start( int start_ws )
       n_stealable = 0;
     }
   }
+  if( WOOL_RECV_INIT ) {
+    // Tasks only leave the pool when thieves ask for them
+    n_stealable = 0;
+  } else if( CHASE_LEV_SYNC ) {
+    // Thieves go by cl_top instead
+    n_stealable = INT_MAX;
+  }
 
   if( workers_per_thread == 0 ) {
     // One worker per thread is typically enough with (transitive)
@@ -3591,6 +5897,7 @@ static void rts_init_start( int start_ws )
 
   // By default, we poll up to the square root of the number of workers
   #if WOOL_STEAL_SAMPLE
+    global_poll_size = poll_size_option;
     if( global_poll_size == 0 ) {
       do {
         global_poll_size++;
@@ -3599,6 +5906,7 @@ static void rts_init_start( int start_ws )
     if( global_poll_size > n_workers-1 ) global_poll_size = n_workers-1;
   #endif
 
+  max_old_thieves = max_old_thieves_option;
   if( max_old_thieves == -1 ) {
     max_old_thieves = n_procs / 4 + 1;
   }
@@ -3623,6 +5931,17 @@ static void rts_init_start( int start_ws )
 
   tls_self = _WOOL_(key_create)();
 
+  init_inject_queue();
+
+  asym_fence_init();
+
+#ifndef __APPLE__
+  if( affinity_mode == PLACE_COMPACT || affinity_mode == PLACE_SCATTER ||
+      affinity_mode == PLACE_CORES_FIRST ) {
+    make_placement( affinity_mode );
+  }
+#endif
+
   milestone_bcw = us_elapsed();
 
   // We only start thread leaders here; the helpers are either fibres or started later
@@ -3680,8 +5999,8 @@ int wool_init_options( int argc, char **argv )
   cpu_set_t mask;
 
   // Default number of processes and worker affinities are given by looking at the
-  // affinity of the root worker.
-  affinity_mode = 3;
+  // affinity of the root worker, placing one thread per physical core first.
+  affinity_mode = PLACE_CORES_FIRST;
   sched_getaffinity( 0, sizeof(cpu_set_t), &mask );
   n_procs = CPU_COUNT( &mask );
   while( a_ctr < n_procs ) {
@@ -3691,26 +6010,44 @@ int wool_init_options( int argc, char **argv )
     }
     i++;
   }
+  discover_topology( &mask );
 #endif
   a_ctr = 0; // In case there are command line options for affinity
 
   workers_per_thread = 0;
   opterr = 0;
 
-  if( argc == 0 ) return 0; // Sometimes we start Wool without giving it any command line options, but we still want the affinity set.
+  // Options from an earlier start do not carry over
+  n_stealable_option = -1;
+  max_old_thieves_option = -1;
+  #if WOOL_STEAL_SAMPLE
+    poll_size_option = 0;
+  #endif
+  #if WOOL_STEAL_NEW_SET
+    victim_policy_name = WOOL_STEAL_HIER ? "hier" : NULL;
+  #endif
+
+  if( argc == 0 ) {
+    // Sometimes we start Wool without giving it any command line options,
+    // but we still want the affinity set and the default victim policy
+    #if WOOL_STEAL_NEW_SET
+      choose_victim_policy( );
+    #endif
+    return 0;
+  }
 
   // An old Solaris box I love does not support long options...
   while( 1 ) {
     int c;
 
-    c = getopt( argc, argv, "a:b:c:d:e:f:g:h:i:j:k:l:m:n:o:p:q:r:s:t:u:v:w:x:y:z:L:R:" );
+    c = getopt( argc, argv, "a:b:c:d:e:f:g:h:i:j:k:l:m:n:o:p:q:r:s:t:u:v:w:x:y:z:B:G:H:L:M:P:R:T:V:" );
 
     if( c == -1 || c == '?' ) break;
 
     switch( c ) {
       case 'p': n_procs = atoi( optarg );
                 break;
-      case 's': n_stealable = atoi( optarg );
+      case 's': n_stealable_option = atoi( optarg );
                 break;
 #if 1
       case 'b': backoff_mode = atoi( optarg );
@@ -3724,7 +6061,7 @@ int wool_init_options( int argc, char **argv )
                 break;
       case 'i': sleep_interval = atoi( optarg );
                 break;
-      case 'o': max_old_thieves = atoi( optarg );
+      case 'o': max_old_thieves_option = atoi( optarg );
                 break;
 #if LOG_EVENTS
       case 'e': event_mask = atoi( optarg );
@@ -3772,7 +6109,7 @@ int wool_init_options( int argc, char **argv )
                 break;
 #endif
 #if WOOL_STEAL_SAMPLE
-      case 'g': global_poll_size  = atoi( optarg );
+      case 'g': poll_size_option  = atoi( optarg );
                 break;
 #endif
 #if WOOL_STEAL_SAMPLE && WOOL_STEAL_NEW_SET
@@ -3805,6 +6142,29 @@ int wool_init_options( int argc, char **argv )
 #endif
       case 'L': global_trlf_threshold = atoi( optarg );
                 break;
+#if WOOL_STEAL_NEW_SET
+      case 'H': hier_rounds = atoi( optarg );
+                break;
+      case 'V': victim_policy_name = optarg;
+                break;
+#endif
+#if WOOL_STEAL_BATCH
+      case 'B': steal_batch = atoi( optarg );
+                break;
+#endif
+      case 'G': huge_pages = atoi( optarg );
+                break;
+      case 'P': park_interval = atoi( optarg );
+                break;
+#if WOOL_AFFINITY
+      case 'M': mail_patience = atoi( optarg );
+                break;
+#endif
+      case 'T': park_timeout = atoi( optarg );
+                if( park_timeout_max < park_timeout ) {
+                  park_timeout_max = park_timeout;
+                }
+                break;
 #if COUNT_EVENTS
       case 'R': global_report_type = report_type( optarg );
                 break;
@@ -3818,6 +6178,10 @@ int wool_init_options( int argc, char **argv )
   argc = argc-optind+1;
   optind = 1;
 
+  #if WOOL_STEAL_NEW_SET
+    choose_victim_policy( );
+  #endif
+
   return argc;
 
 }
@@ -64,3 +64,197 @@ int fib2( int n )
       return m+k;
    }
 }
+
+/* Submission from a thread that is not a worker. */
+
+static void *inj_pfib( void *arg )
+{
+    return (void *) (long) CALL( pfib, (int) (long) arg );
+}
+
+static wool_future_t *volatile inj_future = NULL;
+
+static void *inj_submitter( void *arg )
+{
+    wool_future_t *f = wool_submit( inj_pfib, arg );
+
+    inj_future = f;
+    return wool_future_wait( f );
+}
+
+/* An argument list too large for a task descriptor, spilled to the arena. */
+
+typedef struct { long v[32]; } big_arg_t;
+
+static long big_seq( long v, long w, int n )
+{
+    return n < 2 ? v + w + n : big_seq( v+1, w, n-1 ) + big_seq( v, w, n-2 );
+}
+
+TASK_2( long, big_fib, big_arg_t, a, int, n )
+{
+    if( n < 2 ) {
+        return a.v[0] + a.v[31] + n;
+    } else {
+        big_arg_t b = a;
+        long r;
+
+        b.v[0]++;
+        SPAWN( big_fib, b, n-1 );
+        r = CALL( big_fib, a, n-2 );
+        return r + SYNC( big_fib );
+    }
+}
+
+/* An argument whose alignment puts it, with the padding in front of it,
+   past the end of a descriptor even though its size alone would fit. */
+
+typedef struct { long v[4]; } __attribute__((aligned(64))) wide_arg_t;
+
+static long wide_seq( long w, int n )
+{
+    return n == 0 ? 1 + w : wide_seq( w+n, n-1 ) + wide_seq( w, n-1 );
+}
+
+TASK_2( long, wide_sum, wide_arg_t, a, int, n )
+{
+    if( n == 0 ) {
+        return a.v[0] + a.v[3];
+    } else {
+        wide_arg_t b = a;
+        long r;
+
+        b.v[3] += n;
+        SPAWN( wide_sum, b, n-1 );
+        SPAWN( wide_sum, a, n-1 );
+        r = SYNC( wide_sum );
+        return r + SYNC( wide_sum );
+    }
+}
+
+/* More outstanding spawns than the initial block table has room for. */
+
+TASK_1( long, sq_leaf, long, i )
+{
+    return i * i % 7;
+}
+
+TASK_1( long, many_spawns, long, n )
+{
+    long i, s = 0;
+
+    for( i = 0; i < n; i++ ) {
+        SPAWN( sq_leaf, i );
+    }
+    for( i = n-1; i >= 0; i-- ) {
+        s += SYNC( sq_leaf );
+    }
+    return s;
+}
+
+/* One outstanding spawn at a time, so that the owner and the thieves keep
+   racing for the same, last, task. */
+
+TASK_1( long, spawn_sync_pairs, long, n )
+{
+    long i, s = 0;
+
+    for( i = 0; i < n; i++ ) {
+        SPAWN( sq_leaf, i );
+        s += CALL( sq_leaf, i+1 );
+        s += SYNC( sq_leaf );
+    }
+    return s;
+}
+
+/* A parallel loop; each iteration writes its own element. */
+
+LOOP_BODY_1( sq_fill, SMALL_BODY, int, i, long *, a )
+{
+    a[i] = (long) i * i;
+}
+
+/* The same loop over chunks. Chunks end on a multiple of
+   WOOL_VECTOR_WIDTH, except the one that ends the loop at 'end'; the last
+   element of a chunk records if not. */
+
+RANGE_BODY_2( sq_fill_chunk, SMALL_BODY, int, from, to, long *, a, int, end )
+{
+    int i;
+    for( i = from; i < to; i++ ) {
+        a[i] = (long) i * i;
+    }
+    if( to % WOOL_VECTOR_WIDTH != 0 && to != end ) {
+        a[to-1] = -1;
+    }
+}
+
+/* A parallel reduction; sums the squares of the indices. */
+
+#define SUM(x,y) ((x)+(y))
+
+REDUCE_BODY_0( sq_sum, SMALL_BODY, int, i, long, 0, SUM )
+{
+    return (long) i * i;
+}
+
+#if WOOL_REDUCERS
+
+/* A reducer that appends to a list; the result must come out in the
+   order of the sequential program however the tree was stolen. */
+
+typedef struct {
+    int *a;
+    int n, cap;
+} int_list_t;
+
+static void list_identity( void *v )
+{
+    int_list_t *l = v;
+    l->a = NULL;
+    l->n = l->cap = 0;
+}
+
+static void list_append( int_list_t *l, int x )
+{
+    if( l->n == l->cap ) {
+        l->cap = l->cap ? 2 * l->cap : 16;
+        l->a = realloc( l->a, l->cap * sizeof(int) );
+    }
+    l->a[l->n++] = x;
+}
+
+static void list_reduce( void *left, void *right )
+{
+    int_list_t *l = left, *r = right;
+    int i;
+    for( i = 0; i < r->n; i++ ) {
+        list_append( l, r->a[i] );
+    }
+    free( r->a );
+}
+
+static int_list_t leaves;
+static wool_reducer_t leaves_r = WOOL_REDUCER( sizeof(int_list_t), list_identity, list_reduce, &leaves );
+
+VOID_TASK_2( list_tree, int, lo, int, hi )
+{
+    if( hi - lo == 1 ) {
+        list_append( REDUCER_VIEW( &leaves_r ), lo );
+    } else {
+        int mid = (lo + hi) / 2;
+        SPAWN( list_tree, mid, hi );
+        CALL( list_tree, lo, mid );
+        SYNC( list_tree );
+    }
+}
+
+/* A submitted root task collects into views of its own. */
+
+static void *inj_list( void *arg )
+{
+    CALL( list_tree, 0, (int) (long) arg );
+    return NULL;
+}
+
+#endif